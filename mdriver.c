@@ -21,6 +21,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -41,8 +42,11 @@
 #define REF_ONLY 0
 #endif
 
-/* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
+/* Most threads the speed test can replay a trace on (-m) */
+#define MAX_THREADS 64
+
+/* Returns true if p is align-byte aligned */
+#define IS_ALIGNED(p, align)  ((((unsigned long)(p)) % (align)) == 0)
 
 /* weights */
 typedef enum { WNONE, WALL, WUTIL, WPERF } weight_t;
@@ -81,9 +85,11 @@ typedef struct {
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-    enum { ALLOC, FREE, REALLOC } type; /* type of request */
+    enum { ALLOC, FREE, REALLOC, ALLOC_BATCH, FREE_BATCH, ALLOC_ALIGNED } type; /* type of request */
     long index;                         /* index for free() to use later */
     size_t size;                        /* byte size of alloc/realloc request */
+    size_t count;                       /* number of ids, from index on, in a batch */
+    size_t align;                       /* alignment asked of an aligned alloc */
 } traceop_t;
 
 /* Holds the information for one trace file */
@@ -109,6 +115,13 @@ typedef struct {
     range_set_t *ranges;
 } speed_t;
 
+/* The params to replay_trace: one thread's run through a shared trace */
+typedef struct {
+    trace_t *trace;
+    char **blocks;        /* this thread's pointers returned by malloc/realloc */
+    size_t *sizes;        /* ... and the sizes they were asked for, for -z */
+} replay_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* set in read_trace */
@@ -123,6 +136,10 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;       /* space utilization for this trace (always 0 for libc) */
+    double util_addr;  /* utilization with address-ordered free lists (-a only) */
+    double sbrks;      /* number of mem_sbrk calls while measuring util */
+    bool counted;      /* were the heap stats below kept? (MM_STATS only) */
+    struct mm_stats heap; /* heap stats at the end of the util run */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -162,6 +179,9 @@ int verbose = REF_ONLY ? 0 : 1;  /* global flag for verbose output */
 static int errors = 0;           /* number of errs found when running student malloc */
 static bool onetime_flag = false;
 static bool tab_mode = false;     /* Print output as tab-separated fields */
+static bool compare_insert = false; /* Also measure util with address-ordered free lists */
+static int num_threads = 1;       /* Threads replaying each trace in the speed test */
+static bool sized_free = false;   /* Free with mm_free_sized instead of mm_free */
 /* If set, use sparse memory emulation */
 static bool sparse_mode = SPARSE_MODE;
 static size_t maxfill = SPARSE_MODE ? MAXFILL_SPARSE : MAXFILL;
@@ -225,9 +245,13 @@ static void eval_libc_speed(void *ptr);
 static bool eval_mm_valid(trace_t *trace, range_set_t *ranges);
 static double eval_mm_util(trace_t *trace, int tracenum);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_speed_mt(void *ptr);
+static void *replay_trace(void *ptr);
+static double fsec_wall(test_funct f, void *args);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void printheapstats(const struct mm_stats *heap);
 static void usage(char *prog);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
@@ -274,7 +298,6 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         trace_t *trace;
         trace = read_trace(&mm_stats[i], tracedir, tracefiles[i]);
         strcpy(mm_stats[i].filename, trace->filename);
-        mm_stats[i].ops = trace->num_ops;
 
         /* Prepare for timeout */
         if (setjmp(timeout_jmpbuf) != 0) {
@@ -295,12 +318,21 @@ static void run_tests(int num_tracefiles, const char *tracedir,
             if (verbose > 1)
                 printf("efficiency, ");
             mm_stats[i].util = eval_mm_util(trace, i);
+            mm_stats[i].sbrks = mem_sbrk_calls();
+            mm_stats[i].counted = mm_get_stats(&mm_stats[i].heap);
+            if (compare_insert) {
+                mm_set_insert_policy(MM_INSERT_ADDRESS);
+                mm_stats[i].util_addr = eval_mm_util(trace, i);
+                mm_set_insert_policy(MM_INSERT_LIFO);
+            }
             speed_params->trace = trace;
             speed_params->ranges = ranges;
             if (verbose > 1)
                 printf("and performance.\n");
-            mm_stats[i].secs = sparse_mode ? 1.0 : fsec(eval_mm_speed, speed_params);
-            mm_stats[i].tput = mm_stats[i].ops / (mm_stats[i].secs * 1000.0);
+            mm_stats[i].secs = sparse_mode ? 1.0 :
+                (num_threads > 1 ? fsec_wall(eval_mm_speed_mt, speed_params)
+                                 : fsec(eval_mm_speed, speed_params));
+            mm_stats[i].tput = mm_stats[i].ops * num_threads / (mm_stats[i].secs * 1000.0);
         }
 
         free_trace(trace);
@@ -348,7 +380,7 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hpOVAlDT")) != EOF) {
+    while ((c = getopt(argc, argv, "d:f:c:s:t:v:F:m:hpOVAlDTaz")) != EOF) {
         switch (c) {
 
         case 'A': /* Hidden Autolab driver argument */
@@ -405,6 +437,39 @@ int main(int argc, char **argv)
             tab_mode = true;
             break;
 
+        case 'a': /* Compare LIFO and address-ordered free lists */
+            compare_insert = true;
+            break;
+
+        case 'm': /* Replay each trace on several threads in the speed test */
+            num_threads = atoi(optarg);
+            if (num_threads < 1 || num_threads > MAX_THREADS)
+                app_error("The number of threads must be between 1 and %d\n", MAX_THREADS);
+            if (num_threads > 1 && !mm_thread_safe)
+                app_error("-m needs a thread-safe mm package; use mdriver-mt\n");
+            break;
+
+        case 'z': /* Tell mm_free_sized each block's size */
+            sized_free = true;
+            break;
+
+        case 'F': /* Fit policy used by mm_malloc */
+            if (strcmp(optarg, "first") == 0)
+                mm_set_fit_policy(MM_FIT_FIRST);
+            else if (strcmp(optarg, "next") == 0)
+                mm_set_fit_policy(MM_FIT_NEXT);
+            else if (strncmp(optarg, "good", 4) == 0) {
+                /* good or good:<n>, n being the scan limit */
+                mm_set_fit_policy(MM_FIT_GOOD);
+                if (optarg[4] == ':')
+                    mm_set_fit_scan_limit(atoi(optarg + 5));
+            }
+            else {
+                usage(argv[0]);
+                exit(1);
+            }
+            break;
+
         case 'h': /* Print this message */
             usage(argv[0]);
             exit(0);
@@ -685,22 +750,34 @@ static bool add_range(range_set_t *ranges, char *lo, size_t size,
 
     assert(size > 0);
 
-    /* Payload addresses must be ALIGNMENT-byte aligned */
-    if (!IS_ALIGNED(lo)) {
+    /* Payload addresses must be ALIGNMENT-byte aligned, or aligned as
+       an aligned request asked if that is stricter */
+    size_t align = ALIGNMENT;
+    if (trace->ops[opnum].type == ALLOC_ALIGNED && trace->ops[opnum].align > align)
+        align = trace->ops[opnum].align;
+    if (!IS_ALIGNED(lo, align)) {
         malloc_error(trace, opnum,
-                     "Payload address (%p) not aligned to %d bytes", lo, ALIGNMENT);
+                     "Payload address (%p) not aligned to %zu bytes", lo, align);
         return false;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of one of the heap's regions,
+       or of a region the allocator obtained with mem_map */
+    if (!mem_in_heap(lo, size) && !mem_in_map(lo, size)) {
         malloc_error(trace, opnum,
                      "Payload (%p:%p) lies outside heap (%p:%p)",
                      lo, hi, mem_heap_lo(), mem_heap_hi());
         return false;
     }
 
+    /* The allocator must say the block holds at least what was asked for */
+    if (mm_malloc_usable_size(lo) < size) {
+        malloc_error(trace, opnum,
+                     "Usable size of payload (%p) is %zu, less than %zu",
+                     lo, mm_malloc_usable_size(lo), size);
+        return false;
+    }
+
     /* If we can't afford the linear-time loop, we check less thoroughly and
        just assume the overlap will be caught by writing random bits. */
     if (debug_mode == DBG_NONE) return 1;
@@ -861,7 +938,11 @@ static bool check_index(const trace_t *trace, int opnum, int index) {
  *********************************************/
 
 /*
- * read_trace - read a trace file and store it in memory
+ * read_trace - read a trace file and store it in memory.  Besides the
+ *    "a id size", "r id size" and "f id" requests, "A id n size" asks
+ *    mm_malloc_batch for ids id .. id+n-1, "F id n" hands them to
+ *    mm_free_batch, and "m id align size" asks mm_memalign for a block
+ *    aligned to align bytes.
  */
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
                            const char *filename)
@@ -874,6 +955,8 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     int max_index = 0;
     int op_index;
     int ignore = 0;
+    size_t count;
+    long requests = 0;    /* blocks asked for or freed beyond one per op */
 
     if (verbose > 1)
         printf("Reading tracefile: %s\n", filename);
@@ -944,6 +1027,30 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
             trace->ops[op_index].type = FREE;
             trace->ops[op_index].index = index;
             break;
+        case 'm': /* aligned allocation */
+            ignore += fscanf(tracefile, "%u %zu %lu", &index, &count, &size);
+            trace->ops[op_index].type = ALLOC_ALIGNED;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].align = count;
+            trace->ops[op_index].size = size;
+            max_index = (index > max_index) ? index : max_index;
+            break;
+        case 'A': /* allocate ids index .. index+count-1 with one mm_malloc_batch */
+            ignore += fscanf(tracefile, "%u %zu %lu", &index, &count, &size);
+            trace->ops[op_index].type = ALLOC_BATCH;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].count = count;
+            trace->ops[op_index].size = size;
+            max_index = (index + (int)count - 1 > max_index) ? index + (int)count - 1 : max_index;
+            requests += count - 1;
+            break;
+        case 'F': /* free ids index .. index+count-1 with one mm_free_batch */
+            ignore += fscanf(tracefile, "%u %zu", &index, &count);
+            trace->ops[op_index].type = FREE_BATCH;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].count = count;
+            requests += count - 1;
+            break;
         default:
             app_error("Bogus type character (%c) in tracefile %s\n",
                       type[0], trace->filename);
@@ -958,7 +1065,7 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     /* fill in the stats */
     strcpy(stats->filename, trace->filename);
     stats->weight = trace->weight;
-    stats->ops = trace->num_ops;
+    stats->ops = trace->num_ops + requests; /* a batch counts once per block */
 
     return trace;
 }
@@ -998,7 +1105,9 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
 {
     int i;
     int index;
+    int k;
     size_t size;
+    size_t count;
     char *newp;
     char *oldp;
     char *p;
@@ -1042,10 +1151,16 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
+        case ALLOC_ALIGNED: /* mm_memalign */
 
             /* Call the student's malloc */
-            if ((p = mm_malloc(size)) == NULL) {
-                malloc_error(trace, i, "mm_malloc failed.");
+            if (trace->ops[i].type == ALLOC_ALIGNED)
+                p = mm_memalign(trace->ops[i].align, size);
+            else
+                p = mm_malloc(size);
+            if (p == NULL) {
+                malloc_error(trace, i, trace->ops[i].type == ALLOC_ALIGNED ?
+                             "mm_memalign failed." : "mm_malloc failed.");
                 return false;
             }
 
@@ -1071,8 +1186,19 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                 allCheck = false;
             }
 
-            /* Call the student's realloc */
+            /* A size no block can have must fail and leave the block alone */
             oldp = trace->blocks[index];
+            if (mm_realloc(oldp, SIZE_MAX) != NULL) {
+                malloc_error(trace, i, "mm_realloc to SIZE_MAX returned "
+                             "non-NULL.");
+                return false;
+            }
+            if (!check_index(trace, i, index))
+            {
+                allCheck = false;
+            }
+
+            /* Call the student's realloc */
             newp = mm_realloc(oldp, size);
             if ( (newp == NULL) && (size != 0) ) {
                 malloc_error(trace, i, "mm_realloc failed.");
@@ -1125,13 +1251,50 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                 p = trace->blocks[index];
                 remove_range(ranges, p);
             }
-            mm_free(p);
+            if (sized_free)
+                mm_free_sized(p, index == -1 ? 0 : trace->block_sizes[index]);
+            else
+                mm_free(p);
+            break;
+
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            count = trace->ops[i].count;
+            if (mm_malloc_batch(size, count, (void **)&trace->blocks[index]) != count) {
+                malloc_error(trace, i, "mm_malloc_batch failed.");
+                return false;
+            }
+            for (k = index; k < index + (int)count; k++) {
+                if (add_range(ranges, trace->blocks[k], size, trace, i, k) == 0)
+                    return false;
+                trace->block_sizes[k] = size;
+                randomize_block(trace, k);
+            }
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            count = trace->ops[i].count;
+            for (k = index; k < index + (int)count; k++) {
+                if (!check_index(trace, i, k))
+                {
+                    allCheck = false;
+                }
+                remove_range(ranges, trace->blocks[k]);
+            }
+            /* The batch is sorted in place, so the ids lose their blocks */
+            mm_free_batch((void **)&trace->blocks[index], count);
             break;
 
         default:
             app_error("Nonexistent request type in eval_mm_valid");
         }
     }
+    /* Give the free top of the heap back, and check that the heap survives it */
+    mm_trim(0);
+    if (debug_mode == DBG_EXPENSIVE && !mm_checkheap(0)) {
+        malloc_error(trace, trace->num_ops - 1, "mm_checkheap returned false after mm_trim\n");
+        return false;
+    }
+
     /* As far as we know, this is a valid malloc package */
     return allCheck;
 }
@@ -1140,19 +1303,17 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
  * eval_mm_util - Evaluate the space utilization of the student's package
  *   The idea is to remember the high water mark "hwm" of the heap for
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
- *   Utilization is the ratio hwm/heapsize, where heapsize is the
- *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
+ *   Utilization is the ratio hwm/peak, where peak is the most memory
+ *   the student's malloc package held at once while running the trace:
+ *   the heap plus any regions it obtained with mem_map.
  *
  *   A higher number is better: 1 is optimal.
  */
 static double eval_mm_util(trace_t *trace, int tracenum)
 {
-    int i;
+    int i, k;
     int index;
-    size_t size, newsize, oldsize;
+    size_t size, newsize, oldsize, count;
     size_t max_total_size = 0;
     size_t total_size = 0;
     char *p;
@@ -1169,10 +1330,15 @@ static double eval_mm_util(trace_t *trace, int tracenum)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
+        case ALLOC_ALIGNED: /* mm_memalign */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
 
-            if ((p = mm_malloc(size)) == NULL) {
+            if (trace->ops[i].type == ALLOC_ALIGNED)
+                p = mm_memalign(trace->ops[i].align, size);
+            else
+                p = mm_malloc(size);
+            if (p == NULL) {
                 app_error("trace %d: mm_malloc failed in eval_mm_util",
                           tracenum);
             }
@@ -1217,6 +1383,29 @@ static double eval_mm_util(trace_t *trace, int tracenum)
             total_size -= size;
             break;
 
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            count = trace->ops[i].count;
+            if (mm_malloc_batch(size, count, (void **)&trace->blocks[index]) != count) {
+                app_error("trace %d: mm_malloc_batch failed in eval_mm_util",
+                          tracenum);
+            }
+            for (k = index; k < index + (int)count; k++) {
+                trace->block_sizes[k] = size;
+            }
+            total_size += size * count;
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            index = trace->ops[i].index;
+            count = trace->ops[i].count;
+            for (k = index; k < index + (int)count; k++) {
+                total_size -= trace->block_sizes[k];
+            }
+            mm_free_batch((void **)&trace->blocks[index], count);
+            break;
+
         default:
             app_error("trace %d: Nonexistent request type in eval_mm_util",
                       tracenum);
@@ -1231,7 +1420,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
     printf(".");
 #endif
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    return ((double)max_total_size / (double)mem_peaksize());
 }
 
 
@@ -1242,6 +1431,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 static void eval_mm_speed(void *ptr)
 {
     int i, index;
+    size_t k;
     size_t size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
@@ -1262,6 +1452,16 @@ static void eval_mm_speed(void *ptr)
             if ((p = mm_malloc(size)) == NULL)
                 app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            break;
+
+        case ALLOC_ALIGNED: /* mm_memalign */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_memalign(trace->ops[i].align, size)) == NULL)
+                app_error("mm_memalign error in eval_mm_speed");
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
             break;
 
         case REALLOC: /* mm_realloc */
@@ -1271,6 +1471,7 @@ static void eval_mm_speed(void *ptr)
             if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
                 app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
+            trace->block_sizes[index] = newsize;
             break;
 
         case FREE: /* mm_free */
@@ -1280,7 +1481,24 @@ static void eval_mm_speed(void *ptr)
             } else {
                 block = trace->blocks[index];
             }
-            mm_free(block);
+            if (sized_free)
+                mm_free_sized(block, index < 0 ? 0 : trace->block_sizes[index]);
+            else
+                mm_free(block);
+            break;
+
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            index = trace->ops[i].index;
+            if (mm_malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                                (void **)&trace->blocks[index]) != trace->ops[i].count)
+                app_error("mm_malloc_batch error in eval_mm_speed");
+            for (k = 0; sized_free && k < trace->ops[i].count; k++)
+                trace->block_sizes[index + k] = trace->ops[i].size;
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            index = trace->ops[i].index;
+            mm_free_batch((void **)&trace->blocks[index], trace->ops[i].count);
             break;
 
         default:
@@ -1288,6 +1506,127 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_speed_mt - Like eval_mm_speed, but replays the trace on
+ *    num_threads threads at once, all allocating from one heap, to
+ *    measure how the mm package scales.  Each thread keeps its own
+ *    block pointers.  Needs the thread-safe package built by
+ *    "make mdriver-mt", and a heap big enough for num_threads copies
+ *    of the trace.
+ */
+static void eval_mm_speed_mt(void *ptr)
+{
+    int i;
+    trace_t *trace = ((speed_t *)ptr)->trace;
+    pthread_t threads[MAX_THREADS];
+    replay_t replays[MAX_THREADS];
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (!mm_init())
+        app_error("mm_init failed in eval_mm_speed_mt");
+
+    for (i = 0; i < num_threads; i++) {
+        replays[i].trace = trace;
+        if ((replays[i].blocks = calloc(trace->num_ids, sizeof(char *))) == NULL ||
+            (replays[i].sizes = calloc(trace->num_ids, sizeof(size_t))) == NULL)
+            unix_error("calloc failed in eval_mm_speed_mt");
+        if (pthread_create(&threads[i], NULL, replay_trace, &replays[i]) != 0)
+            unix_error("pthread_create failed in eval_mm_speed_mt");
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+        free(replays[i].blocks);
+        free(replays[i].sizes);
+    }
+}
+
+/*
+ * fsec_wall - Returns the elapsed wall-clock time of f(args), best of
+ *    three runs.  fsec counts only the CPU time of the calling thread,
+ *    which misses the work done by the threads of eval_mm_speed_mt.
+ */
+static double fsec_wall(test_funct f, void *args)
+{
+    double best = DBL_MAX;
+    struct timespec start, end;
+
+    for (int run = 0; run < 3; run++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        f(args);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double secs = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        if (secs < best)
+            best = secs;
+    }
+    return best;
+}
+
+/*
+ * replay_trace - The body of each eval_mm_speed_mt thread: runs every
+ *    request of the trace against the mm package.
+ */
+static void *replay_trace(void *ptr)
+{
+    int i, index;
+    char *p, *newp;
+    trace_t *trace = ((replay_t *)ptr)->trace;
+    char **blocks = ((replay_t *)ptr)->blocks;
+    size_t *sizes = ((replay_t *)ptr)->sizes;
+    size_t k;
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            if ((p = mm_malloc(trace->ops[i].size)) == NULL)
+                app_error("mm_malloc error in replay_trace");
+            blocks[index] = p;
+            sizes[index] = trace->ops[i].size;
+            break;
+
+        case ALLOC_ALIGNED: /* mm_memalign */
+            if ((p = mm_memalign(trace->ops[i].align, trace->ops[i].size)) == NULL)
+                app_error("mm_memalign error in replay_trace");
+            blocks[index] = p;
+            sizes[index] = trace->ops[i].size;
+            break;
+
+        case REALLOC: /* mm_realloc */
+            newp = mm_realloc(blocks[index], trace->ops[i].size);
+            if (newp == NULL && trace->ops[i].size != 0)
+                app_error("mm_realloc error in replay_trace");
+            blocks[index] = newp;
+            sizes[index] = trace->ops[i].size;
+            break;
+
+        case FREE: /* mm_free */
+            if (sized_free)
+                mm_free_sized(index < 0 ? NULL : blocks[index], index < 0 ? 0 : sizes[index]);
+            else
+                mm_free(index < 0 ? NULL : blocks[index]);
+            break;
+
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            if (mm_malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                                (void **)&blocks[index]) != trace->ops[i].count)
+                app_error("mm_malloc_batch error in replay_trace");
+            for (k = 0; sized_free && k < trace->ops[i].count; k++)
+                sizes[index + k] = trace->ops[i].size;
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            mm_free_batch((void **)&blocks[index], trace->ops[i].count);
+            break;
+
+        default:
+            app_error("Nonexistent request type in replay_trace");
+        }
+    }
+    return NULL;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1297,6 +1636,7 @@ static void eval_mm_speed(void *ptr)
 static bool eval_libc_valid(trace_t *trace)
 {
     int i;
+    size_t k;
     size_t newsize;
     char *p, *newp, *oldp;
 
@@ -1313,6 +1653,14 @@ static bool eval_libc_valid(trace_t *trace)
             trace->blocks[trace->ops[i].index] = p;
             break;
 
+        case ALLOC_ALIGNED: /* aligned_alloc */
+            if ((p = aligned_alloc(trace->ops[i].align, trace->ops[i].size)) == NULL) {
+                malloc_error(trace, i, "libc aligned_alloc failed");
+                unix_error("System message");
+            }
+            trace->blocks[trace->ops[i].index] = p;
+            break;
+
         case REALLOC: /* realloc */
             newsize = trace->ops[i].size;
             oldp = trace->blocks[trace->ops[i].index];
@@ -1331,6 +1679,21 @@ static bool eval_libc_valid(trace_t *trace)
             }
             break;
 
+        case ALLOC_BATCH: /* malloc, once per block */
+            for (k = 0; k < trace->ops[i].count; k++) {
+                if ((p = malloc(trace->ops[i].size)) == NULL) {
+                    malloc_error(trace, i, "libc malloc failed");
+                    unix_error("System message");
+                }
+                trace->blocks[trace->ops[i].index + k] = p;
+            }
+            break;
+
+        case FREE_BATCH: /* free, once per block */
+            for (k = 0; k < trace->ops[i].count; k++)
+                free(trace->blocks[trace->ops[i].index + k]);
+            break;
+
         default:
             app_error("invalid operation type  in eval_libc_valid");
         }
@@ -1347,6 +1710,7 @@ static bool eval_libc_valid(trace_t *trace)
 static void eval_libc_speed(void *ptr)
 {
     int i;
+    size_t k;
     int index;
     size_t size, newsize;
     char *p, *newp, *oldp, *block;
@@ -1364,6 +1728,14 @@ static void eval_libc_speed(void *ptr)
             trace->blocks[index] = p;
             break;
 
+        case ALLOC_ALIGNED: /* aligned_alloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = aligned_alloc(trace->ops[i].align, size)) == NULL)
+                unix_error("aligned_alloc failed in eval_libc_speed");
+            trace->blocks[index] = p;
+            break;
+
         case REALLOC: /* realloc */
             index = trace->ops[i].index;
             newsize = trace->ops[i].size;
@@ -1383,6 +1755,21 @@ static void eval_libc_speed(void *ptr)
                 free(0);
             }
             break;
+
+        case ALLOC_BATCH: /* malloc, once per block */
+            index = trace->ops[i].index;
+            for (k = 0; k < trace->ops[i].count; k++) {
+                if ((p = malloc(trace->ops[i].size)) == NULL)
+                    unix_error("malloc failed in eval_libc_speed");
+                trace->blocks[index + k] = p;
+            }
+            break;
+
+        case FREE_BATCH: /* free, once per block */
+            index = trace->ops[i].index;
+            for (k = 0; k < trace->ops[i].count; k++)
+                free(trace->blocks[index + k]);
+            break;
         }
     }
 }
@@ -1392,6 +1779,38 @@ static void eval_libc_speed(void *ptr)
  ************************************/
 
 
+/*
+ * printheapstats - prints the heap stats of a trace on the line below its
+ *                  results, and the free blocks per size class after them
+ */
+static void printheapstats(const struct mm_stats *heap)
+{
+    int i;
+
+    if (tab_mode) {
+        printf("heap\tlive\t%zu\tfree\t%zu\tsplits\t%zu\tcoalesces\t%zu\t"
+               "fits\t%zu\tprobes\t%.2f\tmax\t%zu\textends\t%zu\tclasses",
+               heap->live_bytes, heap->free_bytes, heap->splits,
+               heap->coalesces, heap->fit_calls, heap->fit_probes_mean,
+               heap->fit_probes_max, heap->extend_calls);
+        for (i = 0; i < MM_STATS_CLASSES; i++)
+            printf("\t%zu", heap->free_blocks[i]);
+        printf("\n");
+    } else {
+        printf("        live %zu free %zu splits %zu coalesces %zu extends %zu"
+               " probes %.2f/fit (max %zu, %zu fits)\n",
+               heap->live_bytes, heap->free_bytes, heap->splits,
+               heap->coalesces, heap->extend_calls, heap->fit_probes_mean,
+               heap->fit_probes_max, heap->fit_calls);
+        printf("        free blocks:");
+        for (i = 0; i < MM_STATS_CLASSES; i++)
+            if (heap->free_blocks[i] != 0)
+                printf(" %lu%s:%zu", 16ul << i,
+                       i == MM_STATS_CLASSES - 1 ? "+" : "", heap->free_blocks[i]);
+        printf("\n");
+    }
+}
+
 /*
  * printresults - prints a performance summary for some malloc package and returns
  *                a summary of the stats to the caller.
@@ -1405,6 +1824,8 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
     double sumops  = 0;
     double sumtput = 0;
     double sumutil = 0;
+    double sumutil_addr = 0;
+    double sumsbrks = 0;
     int sum_perf_weight = 0;
     int sum_util_weight = 0;
 
@@ -1413,10 +1834,12 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
 
     /* Print the individual results for each trace */
     if (tab_mode) {
-        printf("valid\tthru?\tutil?\tutil\tops\tmsecs\tKops\ttrace\n");
+        printf("valid\tthru?\tutil?\tutil\t%ssbrks\tops\tmsecs\tKops\ttrace\n",
+               compare_insert ? "addr\t" : "");
     } else {
-        printf("  %5s  %6s %7s%8s%8s  %s\n",
-               "valid", "util", "ops", "msecs", "Kops", "trace");
+        printf("  %5s  %6s%s %6s %7s%8s%8s  %s\n",
+               "valid", "util", compare_insert ? "     addr" : "",
+               "sbrks", "ops", "msecs", "Kops", "trace");
     }
     for (i=0; i < n; i++) {
         if (stats[i].valid) {
@@ -1455,13 +1878,23 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
             /* Utilization */
             if (tab_mode) {
                 printf("%.1f\t", stats[i].util * 100.0);
+                if (compare_insert)
+                    printf("%.1f\t", stats[i].util_addr * 100.0);
+                printf("%.0f\t", stats[i].sbrks);
             } else {
                 /* print '--' if util isn't weighted */
                 if (stats[i].weight == WNONE || stats[i].weight == WALL
-                    || stats[i].weight == WUTIL)
+                    || stats[i].weight == WUTIL) {
                     printf(" %7.1f%%", stats[i].util * 100.0);
-                else
+                    if (compare_insert)
+                        printf(" %7.1f%%", stats[i].util_addr * 100.0);
+                    printf(" %6.0f", stats[i].sbrks);
+                } else {
                     printf(" %8s", "--");
+                    if (compare_insert)
+                        printf(" %8s", "--");
+                    printf(" %6s", "--");
+                }
             }
 
             /* Ops + Time */
@@ -1480,6 +1913,8 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
             }
 
             printf("%s\n", stats[i].filename);
+            if (stats[i].counted)
+                printheapstats(&stats[i].heap);
 
             if (stats[i].weight == WALL || stats[i].weight == WPERF)
                 {
@@ -1492,19 +1927,22 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
                 {
                     sum_util_weight += 1;
                     sumutil += stats[i].util;
+                    sumutil_addr += stats[i].util_addr;
+                    sumsbrks += stats[i].sbrks;
                 }
         }
         else {
             if (tab_mode) {
-                printf("no\t\t\t\t\t\t\t%s\n", stats[i].filename);
+                printf("no\t\t\t\t\t\t\t\t%s\n", stats[i].filename);
             } else {
-                printf("%2s%4s%7s%10s%7s%10s %s\n",
+                printf("%2s%4s%7s%7s%10s%7s%10s %s\n",
                        stats[i].weight != 0 ? "*" : "",
                        "no",
                        "-",
                        "-",
                        "-",
                        "-",
+                       "-",
                        stats[i].filename);
             }
         }
@@ -1522,20 +1960,31 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
         if (sparse_mode)
             sumsecs = 0;
         if (tab_mode) {
-            // "valid\tthru?\tutil?\tutil\tops\tmsecs\tKops\ttrace"
-            printf("Sum\t%d\t%d\t%.1f\t%.0f\t\%.2f\n",
+            // "valid\tthru?\tutil?\tutil\tsbrks\tops\tmsecs\tKops\ttrace"
+            printf("Sum\t%d\t%d\t%.1f\t",
                    sum_perf_weight,
                    sum_util_weight,
-                   sumutil * 100.0,
+                   sumutil * 100.0);
+            if (compare_insert)
+                printf("%.1f\t", sumutil_addr * 100.0);
+            printf("%.0f\t%.0f\t\%.2f\n",
+                   sumsbrks,
                    sumops,
                    sumsecs * 1000.0);
-            printf("Avg\t\t\t%.1f\t\t\t\n",
+            printf("Avg\t\t\t%.1f\t",
                    util * 100.0);
+            if (compare_insert)
+                printf("%.1f\t", sumutil_addr / (double)sum_util_weight * 100.0);
+            printf("\t\t\t\n");
         } else {
-            printf("%2d %2d  %7.1f%%%8.0f%10.3f\n",
+            printf("%2d %2d  %7.1f%%",
                    sum_util_weight,
                    sum_perf_weight,
-                   util * 100.0,
+                   util * 100.0);
+            if (compare_insert)
+                printf(" %7.1f%%", sumutil_addr / (double)sum_util_weight * 100.0);
+            printf(" %6.0f%8.0f%10.3f\n",
+                   sumsbrks,
                    sumops,
                    sumsecs * 1000.0);
         }
@@ -1698,5 +2147,11 @@ static void usage(char *prog)
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-T         Print diagnostics in tab mode\n");
+    fprintf(stderr, "\t-a         Also report util with address-ordered free lists.\n");
+    fprintf(stderr, "\t-F <fit>   Fit policy: first (default), next, or good[:<n>]\n");
+    fprintf(stderr, "\t           (best of the first n fits, default 8).\n");
+    fprintf(stderr, "\t-m <n>     Replay each trace on n threads in the speed test\n");
+    fprintf(stderr, "\t           (mdriver-mt only).\n");
+    fprintf(stderr, "\t-z         Free with mm_free_sized, passing each block's size.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file\n");
 }
@@ -21,13 +21,39 @@
 
 /* private global variables */
 static unsigned char *heap;                 /* Starting address of heap */
-static unsigned char *mem_brk;              /* Current position of break */
-static unsigned char *mem_max_addr;         /* Maximum allowable heap address */
 static size_t mmap_length = MAX_DENSE_HEAP; /* Number of bytes allocated by mmap */
 static bool show_stats = false;             /* Should program print allocation information? */
 static bool stats_printed = false;          /* Has information been printed about allocation */
 
+/* Regions handed out by mem_map, outside the brk heap */
+typedef struct {
+    unsigned char *lo;                      /* first byte of the region */
+    size_t len;                             /* length in bytes, a multiple of the page size */
+} map_region_t;
+static map_region_t *map_regions = NULL;    /* regions currently mapped */
+static size_t map_count = 0;                /* number of regions in map_regions */
+static size_t map_capacity = 0;             /* room in map_regions */
+/* The byte counts are shared by threads growing different regions, so they are
+   only touched with __atomic builtins */
+static size_t heap_bytes = 0;               /* bytes below the breaks, over all regions */
+static size_t mapped_bytes = 0;             /* total length of the mapped regions */
+static size_t peak_bytes = 0;               /* most heap + mapped bytes in use at once */
+static size_t sbrk_calls = 0;               /* mem_sbrk calls since the heap was last reset */
+
+/* The heap is split into disjoint brk regions, each with a break of its own */
+typedef struct {
+    unsigned char *lo;                      /* first byte of the region */
+    unsigned char *brk;                     /* current position of its break */
+    unsigned char *max_addr;                /* maximum allowable address in it */
+    unsigned char *dirty;                   /* end of what has been heap; zero from here up */
+} brk_region_t;
+static brk_region_t regions[MEM_MAX_REGIONS];
+static int region_count = 1;                /* number of regions in use */
+
 static void print_stats();
+static void update_peak(void);
+static void unmap_all(void);
+static unsigned char *dirty_end(unsigned char *lo, unsigned char *hi);
 
 /* 
  * mem_init - initialize the memory system model
@@ -50,10 +76,11 @@ void mem_init(){
     }
     
     heap = addr;
-    mem_max_addr = heap + MAX_DENSE_HEAP;
+    regions[0].lo = heap;
+    regions[0].dirty = heap;
+    region_count = 1;
     
     stats_printed = false;
-    mem_brk = heap;
     mem_reset_brk();
 }
 
@@ -62,39 +89,103 @@ void mem_init(){
  */
 void mem_deinit(void){
     print_stats();
+    unmap_all();
     munmap(heap, mmap_length);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *                 held in a single region
  */
 void mem_reset_brk(){
     print_stats();
-    mem_brk = heap;
+    unmap_all();
+    unsigned char *dirty = dirty_end(heap, heap + MAX_DENSE_HEAP);
+    regions[0].lo = heap;
+    regions[0].brk = heap;
+    regions[0].max_addr = heap + MAX_DENSE_HEAP;
+    regions[0].dirty = dirty;
+    region_count = 1;
+    heap_bytes = 0;
+    peak_bytes = 0;
+    sbrk_calls = 0;
+}
+
+/*
+ * mem_set_regions - split the empty heap into count disjoint regions of
+ *                   equal size, each grown with mem_region_sbrk.  Region 0
+ *                   starts at mem_heap_lo.  Returns 0, or -1 if count is out
+ *                   of range or some region is not empty.
+ */
+int mem_set_regions(int count) {
+    if (count < 1 || count > MEM_MAX_REGIONS) {
+        fprintf(stderr, "ERROR: mem_set_regions failed.  Cannot make %d regions\n", count);
+        return -1;
+    }
+    for (int r = 0; r < region_count; r++) {
+        if (regions[r].brk != regions[r].lo) {
+            fprintf(stderr, "ERROR: mem_set_regions failed.  Region %d is not empty\n", r);
+            return -1;
+        }
+    }
+
+    size_t len = MAX_DENSE_HEAP / count / mem_pagesize() * mem_pagesize();
+    unsigned char *dirty[MEM_MAX_REGIONS];
+    for (int r = 0; r < count; r++)
+        dirty[r] = dirty_end(heap + r * len, heap + (r + 1) * len);
+    for (int r = 0; r < count; r++) {
+        regions[r].lo = heap + r * len;
+        regions[r].brk = regions[r].lo;
+        regions[r].max_addr = regions[r].lo + len;
+        regions[r].dirty = dirty[r];
+    }
+    region_count = count;
+    return 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
  *                by incr bytes and returns the start address of the new area. In
- *                this model, the heap cannot be shrunk.
+ *                this model, the heap cannot be shrunk by mem_sbrk; see
+ *                mem_region_trim.
  */
 void *mem_sbrk(intptr_t incr) {
-    unsigned char *old_brk = mem_brk;
+    return mem_region_sbrk(0, incr);
+}
+
+/*
+ * mem_region_sbrk - mem_sbrk for region r of the heap.  Different regions
+ *                   may be grown from different threads at once, so only
+ *                   region 0 moves the real break along with its own.
+ */
+void *mem_region_sbrk(int r, intptr_t incr) {
+    if (r < 0 || r >= region_count) {
+        fprintf(stderr, "ERROR: mem_sbrk failed.  There is no region %d\n", r);
+        errno = ENOMEM;
+        return (void *) -1;
+    }
+    brk_region_t *region = &regions[r];
+    unsigned char *old_brk = region->brk;
+    __atomic_fetch_add(&sbrk_calls, 1, __ATOMIC_RELAXED);
 
     bool ok = true;
     if (incr < 0) {
         ok = false;
         fprintf(stderr, "ERROR: mem_sbrk failed.  Attempt to expand heap by negative value %ld\n", (long) incr);
-    } else if (mem_brk + incr > mem_max_addr) {
+    } else if ((size_t) incr > (size_t) (region->max_addr - region->brk)) {
         ok = false;
-        size_t alloc = mem_brk - heap + incr;
+        size_t alloc = region->brk - region->lo + incr;
         fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory.  Would require heap size of %zd (0x%zx) bytes\n", alloc, alloc);
-    } else if (sbrk(incr) == (void*) -1) {
+    } else if (r == 0 && sbrk(incr) == (void*) -1) {
         ok = false;
         fprintf(stderr, "ERROR: mem_sbrk failed.  Could not allocate more heap space\n");
     }
     if (ok) {
-        mem_brk += incr;
+        region->brk += incr;
+        if (region->dirty < region->brk)
+            region->dirty = region->brk;
+        __atomic_fetch_add(&heap_bytes, incr, __ATOMIC_RELAXED);
+        update_peak();
         return (void *) old_brk;
     } else {
         errno = ENOMEM;
@@ -102,6 +193,147 @@ void *mem_sbrk(intptr_t incr) {
     }
 }
 
+/*
+ * mem_region_trim - shrinks region r of the heap by decr bytes and returns
+ *                   its new break.  The whole pages given up are handed
+ *                   back to the system with madvise.
+ */
+void *mem_region_trim(int r, size_t decr) {
+    if (r < 0 || r >= region_count) {
+        fprintf(stderr, "ERROR: mem_region_trim failed.  There is no region %d\n", r);
+        errno = EINVAL;
+        return (void *) -1;
+    }
+    brk_region_t *region = &regions[r];
+    if (decr > (size_t) (region->brk - region->lo)) {
+        fprintf(stderr, "ERROR: mem_region_trim failed.  Attempt to shrink heap by %zu bytes below its start\n", decr);
+        errno = EINVAL;
+        return (void *) -1;
+    }
+    __atomic_fetch_add(&sbrk_calls, 1, __ATOMIC_RELAXED);
+
+    /* The real break is left alone, since libc may have grown it since */
+    size_t page = mem_pagesize();
+    unsigned char *lo = heap + (region->brk - decr - heap + page - 1) / page * page;
+    if (lo < region->brk) {
+        madvise(lo, region->brk - lo, MADV_DONTNEED);
+        /* Memory above the old break may still hold an earlier heap */
+        if (region->dirty == region->brk)
+            region->dirty = lo;
+    }
+    region->brk -= decr;
+    __atomic_fetch_sub(&heap_bytes, decr, __ATOMIC_RELAXED);
+    return (void *) region->brk;
+}
+
+/*
+ * mem_sbrk_calls - returns how many times mem_sbrk, mem_region_sbrk or
+ *                  mem_region_trim has been called since the heap was
+ *                  last reset.
+ */
+size_t mem_sbrk_calls(void) {
+    return __atomic_load_n(&sbrk_calls, __ATOMIC_RELAXED);
+}
+
+/*
+ * mem_region_clean - returns the lowest address of region r from which
+ *                    the memory has not been part of the heap since it was
+ *                    mapped, or since the whole pages holding it were given
+ *                    back by shrinking the heap.  Memory from there up to
+ *                    the region's end reads as zero.
+ */
+void *mem_region_clean(int r) {
+    return (void *) regions[r].dirty;
+}
+
+/*
+ * dirty_end - returns the end of the memory in [lo, hi) that some region
+ *             has held as heap, or lo if it is all clean.
+ */
+static unsigned char *dirty_end(unsigned char *lo, unsigned char *hi) {
+    unsigned char *end = lo;
+    for (int r = 0; r < region_count; r++) {
+        unsigned char *d = regions[r].dirty;
+        if (d > regions[r].lo && regions[r].lo < hi && d > lo)
+            end = d < hi ? (d > end ? d : end) : hi;
+    }
+    return end;
+}
+
+/*
+ * mem_map - model of an anonymous mmap.  Returns a zeroed, page-aligned
+ *           region of at least len bytes that lies outside the brk heap,
+ *           or (void *) -1 if there is no memory for it.
+ */
+void *mem_map(size_t len) {
+    len = (len + mem_pagesize() - 1) / mem_pagesize() * mem_pagesize();
+
+    if (map_count == map_capacity) {
+        size_t capacity = map_capacity ? 2 * map_capacity : 16;
+        map_region_t *regions = realloc(map_regions, capacity * sizeof(map_region_t));
+        if (regions == NULL) {
+            errno = ENOMEM;
+            return (void *) -1;
+        }
+        map_regions = regions;
+        map_capacity = capacity;
+    }
+
+    void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "ERROR: mem_map failed.  Could not map %zu bytes\n", len);
+        errno = ENOMEM;
+        return (void *) -1;
+    }
+    map_regions[map_count].lo = addr;
+    map_regions[map_count].len = len;
+    map_count++;
+    __atomic_fetch_add(&mapped_bytes, len, __ATOMIC_RELAXED);
+    update_peak();
+    return addr;
+}
+
+/*
+ * mem_unmap - returns a region obtained from mem_map to the system at
+ *             once.  Returns 0, or -1 if addr does not start a region.
+ */
+int mem_unmap(void *addr) {
+    for (size_t i = 0; i < map_count; i++) {
+        if (map_regions[i].lo == addr) {
+            munmap(addr, map_regions[i].len);
+            __atomic_fetch_sub(&mapped_bytes, map_regions[i].len, __ATOMIC_RELAXED);
+            map_regions[i] = map_regions[--map_count];
+            return 0;
+        }
+    }
+    fprintf(stderr, "ERROR: mem_unmap failed.  %p is not a mapped region\n", addr);
+    return -1;
+}
+
+/*
+ * mem_in_map - returns true if the len bytes at lo lie within one mapped
+ *              region.
+ */
+bool mem_in_map(const void *lo, size_t len) {
+    const unsigned char *p = lo;
+    for (size_t i = 0; i < map_count; i++) {
+        if (p >= map_regions[i].lo && p + len <= map_regions[i].lo + map_regions[i].len)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * mem_in_heap - returns true if the len bytes at lo lie within the used
+ *               part of one region of the heap.
+ */
+bool mem_in_heap(const void *lo, size_t len) {
+    int r = mem_region_of(lo);
+    const unsigned char *p = lo;
+    return r >= 0 && p + len <= regions[r].brk;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -110,17 +342,59 @@ void *mem_heap_lo(){
 }
 
 /* 
- * mem_heap_hi - return address of last heap byte
+ * mem_heap_hi - return address of last heap byte of region 0
  */
 void *mem_heap_hi(){
-    return (void *)(mem_brk - 1);
+    return (void *)(regions[0].brk - 1);
+}
+
+/*
+ * mem_region_lo - return address of the first byte of region r
+ */
+void *mem_region_lo(int r){
+    return (void *) regions[r].lo;
 }
 
 /*
- * mem_heapsize() - returns the heap size in bytes
+ * mem_region_hi - return address of the last byte in use in region r
+ */
+void *mem_region_hi(int r){
+    return (void *)(regions[r].brk - 1);
+}
+
+/*
+ * mem_region_of - returns the region that holds p, used or not, or -1 if
+ *                 p lies outside the heap.
+ */
+int mem_region_of(const void *p){
+    const unsigned char *q = p;
+    for (int r = 0; r < region_count; r++) {
+        if (q >= regions[r].lo && q < regions[r].max_addr)
+            return r;
+    }
+    return -1;
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes, over all regions
  */
 size_t mem_heapsize() {
-    return (size_t)(mem_brk - heap);
+    return __atomic_load_n(&heap_bytes, __ATOMIC_RELAXED);
+}
+
+/*
+ * mem_mapsize() - returns the number of bytes in mapped regions
+ */
+size_t mem_mapsize() {
+    return __atomic_load_n(&mapped_bytes, __ATOMIC_RELAXED);
+}
+
+/*
+ * mem_peaksize() - returns the most bytes held in the heap and in mapped
+ *                  regions together since the heap was last reset
+ */
+size_t mem_peaksize() {
+    return __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
 }
 
 /*
@@ -134,12 +408,32 @@ size_t mem_pagesize(){
 /*************** Private Functions *******************/
 
 
+/*
+ * update_peak - raises peak_bytes to the heap and mapped bytes now in use.
+ *               Called after every increase, by whichever thread made it,
+ *               so a compare-and-swap keeps concurrent raises from losing
+ *               the larger one.
+ */
+static void update_peak(void) {
+    size_t bytes = mem_heapsize() + mem_mapsize();
+    size_t peak = __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
+    while (bytes > peak &&
+           !__atomic_compare_exchange_n(&peak_bytes, &peak, bytes, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void unmap_all(void) {
+    while (map_count > 0)
+        mem_unmap(map_regions[map_count - 1].lo);
+}
+
 static void print_stats() {
     size_t vbytes = mem_heapsize();
     if (!show_stats || vbytes == 0 || stats_printed)
         return;
     printf("Allocated %zu heap bytes.  Max address = %p\n",
-           vbytes, mem_brk);
+           vbytes, regions[region_count - 1].brk);
     stats_printed = true;
 }
 
@@ -2,13 +2,30 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* Most brk regions the heap can be split into */
+#define MEM_MAX_REGIONS 16
+
 void mem_init();               
 void mem_deinit(void);
 void *mem_sbrk(intptr_t incr);
 void mem_reset_brk(void); 
+int mem_set_regions(int count);
+void *mem_region_sbrk(int r, intptr_t incr);
+void *mem_region_trim(int r, size_t decr);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_region_lo(int r);
+void *mem_region_hi(int r);
+int mem_region_of(const void *p);
+void *mem_region_clean(int r);
+bool mem_in_heap(const void *lo, size_t len);
 size_t mem_heapsize(void);
+void *mem_map(size_t len);
+int mem_unmap(void *addr);
+bool mem_in_map(const void *lo, size_t len);
+size_t mem_mapsize(void);
+size_t mem_peaksize(void);
+size_t mem_sbrk_calls(void);
 size_t mem_pagesize(void);
 
 /* Read len bytes and return value zero-extended to 64 bits */
@@ -1,12 +1,96 @@
 /*
  ******************************************************************************
  *                               mm.c                                         *
- *           64-bit struct-based implicit free list memory allocator          *
- *                      without coalesce functionality                        *
+ *        64-bit struct-based segregated free list memory allocator           *
+ *                    with immediate boundary-tag coalescing                  *
  *                 CSE 361: Introduction to Computer Systems                  *
  *                                                                            *
  *  ************************************************************************  *
- *                     insert your documentation here. :)                     *
+ *  Every block carries a one-word header holding its size, its allocation    *
+ *  bit and the allocation bit of the block before it. Allocated blocks have  *
+ *  no footer; free blocks carry a footer and a pair of list pointers, so     *
+ *  find_prev is only needed when the header says the previous block is       *
+ *  free.                                                                     *
+ *                                                                            *
+ *  Free blocks smaller than tree_min_size are kept in one of SEG_LISTS       *
+ *  doubly linked lists, bucketed by size into power-of-two classes.          *
+ *  find_fit starts in the smallest class that can hold the request and       *
+ *  takes the first block that fits, so a malloc only ever looks at blocks    *
+ *  that are roughly the right size. Larger free blocks are nodes of a splay  *
+ *  tree, embedded in the blocks themselves and ordered by size and then      *
+ *  address, which gives the best fit in amortized logarithmic time.          *
+ *                                                                            *
+ *  By default freed blocks are pushed onto the front of their list. With    *
+ *  mm_set_insert_policy(MM_INSERT_ADDRESS) the lists are kept in address     *
+ *  order instead, which packs live blocks towards the bottom of the heap.    *
+ *  The search for the insertion point starts from the list neighbour of a    *
+ *  block that was just merged or split, so it is usually short.              *
+ *                                                                            *
+ *  mm_set_fit_policy(MM_FIT_NEXT) turns the list search into next fit: each  *
+ *  list has a roving pointer, and a search resumes where the last one on     *
+ *  that list ended instead of at its head. MM_FIT_GOOD keeps looking past    *
+ *  the first fit, at up to fit_scan_limit fitting blocks, and takes the      *
+ *  smallest, stopping at once on an exact fit.                               *
+ *                                                                            *
+ *  Requests of up to one word get a 16-byte mini block: a header plus one    *
+ *  pointer. Free mini blocks have no room for a footer or a second link, so  *
+ *  they live on their own singly linked list, and the header of the block    *
+ *  after a mini block has a bit saying so, which lets find_prev step back    *
+ *  over it.                                                                  *
+ *                                                                            *
+ *  Building with COMPACT_LINKS set stores the list links as 32-bit offsets   *
+ *  from the start of the heap, so a header and both links fit in 16 bytes.  *
+ *  Mini blocks are then doubly linked on the first segregated list like     *
+ *  any other block, and the TLSF engine can split off 16-byte blocks too.   *
+ *                                                                            *
+ *  realloc works in place where it can: shrinking splits off the unused      *
+ *  tail, and growing absorbs a free successor or, at the top of the heap,    *
+ *  extends the heap by the shortfall. Only otherwise does it copy the        *
+ *  payload to a new block.                                                   *
+ *                                                                            *
+ *  mm_trim hands a free block at the top of the heap back to memlib with    *
+ *  mem_region_trim, so a heap that spiked once does not stay at its peak.    *
+ *                                                                            *
+ *  Requests of map_threshold bytes and up bypass the heap: each gets a       *
+ *  region of its own from mem_map, with the header one word into the first  *
+ *  page, and free hands the region straight back with mem_unmap. A payload  *
+ *  outside the heap's address range therefore belongs to a mapped block.    *
+ *                                                                            *
+ *  Building with THREADS set makes the allocator thread-safe. The heap is    *
+ *  split into ARENAS arenas, each a heap of its own in a separate memlib     *
+ *  region with its own free lists and lock, and threads are handed arenas   *
+ *  round robin. A block is always freed into the arena whose region holds   *
+ *  it. A thread freeing another arena's block never takes that arena's     *
+ *  lock: it pushes the block onto the arena's lock-free remote list, which   *
+ *  is drained in one go by the next thread to lock the arena. Each thread    *
+ *  also keeps a cache of up to TCACHE_SIZE slab objects per class, so that   *
+ *  small mallocs and frees usually take no lock at all. A cache that runs    *
+ *  dry or overflows moves half its capacity to or from the slabs.            *
+ *                                                                            *
+ *  Building with TLSF set swaps the lists and the tree for a two-level       *
+ *  segregated fit index: size classes split first by power of two and then   *
+ *  into TLSF_SL_COUNT steps, with a bitmap per level, so that find_fit,      *
+ *  insert_at_front and remove_block are constant time. Placement, splitting  *
+ *  and coalescing are shared with the default engine.                        *
+ *                                                                            *
+ *  Requests of up to slab_max_size bytes come from slabs instead: page-      *
+ *  sized heap blocks whose payload starts on a page boundary, each cut into  *
+ *  equal objects of one of SLAB_CLASSES sizes. Objects carry no header. A    *
+ *  bitmap over the heap's pages tells free whether a pointer lies in a       *
+ *  slab, and each slab keeps a bitmap of its free objects, so both malloc    *
+ *  and free are a few bit operations. A slab that empties is freed back      *
+ *  into the heap as an ordinary block.                                       *
+ *                                                                            *
+ *  Building with DEFER_COALESCE set makes free lazy: blocks of up to        *
+ *  quick_max_size bytes stay marked allocated and go onto a quick list for   *
+ *  their exact size, where malloc picks them up again without splitting.     *
+ *  They are only freed and coalesced, all at once, when find_fit fails.      *
+ *                                                                            *
+ *  Building with BUDDY set runs the heap as a binary buddy system instead:   *
+ *  every block is a power of two long and starts at a multiple of its size   *
+ *  from heap_start, so the buddy it merges with is found by flipping one     *
+ *  bit of its offset. Free blocks sit on one list per order, with a bitmap   *
+ *  of the non-empty orders.                                                  *
  *                                                                            *
  *  ************************************************************************  *
  *  ** ADVICE FOR STUDENTS. **                                                *
@@ -27,6 +111,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <stddef.h>
+#include <pthread.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -37,10 +122,20 @@
 #define free mm_free
 #define realloc mm_realloc
 #define calloc mm_calloc
+#define memalign mm_memalign
+#define aligned_alloc mm_aligned_alloc
+#define posix_memalign mm_posix_memalign
+#define malloc_usable_size mm_malloc_usable_size
 #endif /* def DRIVER */
 
 /* You can change anything from here onward */
 
+#include "config.h"
+#include <errno.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*
  * If DEBUG is defined, enable printing on dbg_printf and contracts.
  * Debugging macros, with names beginning "dbg_" are allowed.
@@ -62,24 +157,200 @@
 #define dbg_ensures(...)
 #endif
 
+/*
+ * If TLSF is nonzero, free blocks are indexed by a two-level segregated fit
+ * engine instead of the segregated lists and the splay tree: find_fit,
+ * insert_at_front and remove_block then all run in constant time, which
+ * bounds the worst-case latency of malloc and free.  The engine has no
+ * mini blocks, since unlinking a block from the singly linked mini list
+ * takes linear time.  Build it with "make mdriver-tlsf".
+ */
+#ifndef TLSF
+#define TLSF 0
+#endif
+
+/*
+ * If DEFER_COALESCE is nonzero, free puts small blocks on quick lists of
+ * exact sizes instead of coalescing them, so alloc/free churn of one size
+ * reuses the same block without a merge and a split each time.  The quick
+ * lists are emptied into the free lists in one sweep when find_fit fails.
+ * Build it with "make MMFLAGS=-DDEFER_COALESCE=1".
+ */
+#ifndef DEFER_COALESCE
+#define DEFER_COALESCE 0
+#endif
+
+/*
+ * If THREADS is nonzero, malloc, free and realloc may be called from many
+ * threads at once: the heap is split into ARENAS arenas, each only touched
+ * with its own lock held, and small requests are served from per-thread
+ * caches without any lock.  Build it with "make mdriver-mt".
+ */
+#ifndef THREADS
+#define THREADS 0
+#endif
+#define ARENAS (THREADS ? 4 : 1)
+
+/*
+ * If BUDDY is nonzero, the heap is run as a binary buddy system: requests
+ * are rounded up to a power of two and coalescing is a constant-time
+ * address computation instead of a footer lookup.  The engine replaces the
+ * lists, the tree and the slabs, and exists to be compared against them on
+ * the same traces.  Build it with "make mdriver-buddy".
+ */
+#ifndef BUDDY
+#define BUDDY 0
+#endif
+
+/*
+ * If COMPACT_LINKS is nonzero, the previous/next links of free blocks are
+ * 32-bit offsets from mem_heap_lo instead of pointers, which MAX_DENSE_HEAP
+ * allows.  A free block then needs only 16 bytes, so min_block_size drops
+ * to that of a mini block and small remainders of a split stay usable.
+ * Build it with "make MMFLAGS=-DCOMPACT_LINKS=1".
+ */
+#ifndef COMPACT_LINKS
+#define COMPACT_LINKS 0
+#endif
+
+/*
+ * If MM_STATS is nonzero, each arena counts splits, coalesces, find_fit
+ * probes and extend_heap calls for mm_get_stats.  Otherwise the counting
+ * compiles away.  Build it with "make MMFLAGS=-DMM_STATS=1".
+ */
+#ifndef MM_STATS
+#define MM_STATS 0
+#endif
+
 /* Basic constants */
 typedef uint64_t word_t;
 static const size_t wsize = sizeof(word_t);   // word and header size (bytes)
 static const size_t dsize = 2*sizeof(word_t);       // double word size (bytes)
-static const size_t min_block_size = 4*sizeof(word_t); // Minimum block size
+static const size_t min_block_size = COMPACT_LINKS ? 2*sizeof(word_t) : 4*sizeof(word_t); // Minimum size of a regular block
+static const size_t mini_block_size = 2*sizeof(word_t); // Size of a mini block: header + one pointer, or two compact links
+static const size_t smallest_block_size = (TLSF && !COMPACT_LINKS) ? 4*sizeof(word_t) : 2*sizeof(word_t); // Smallest block ever made
 static const size_t chunksize = (1 << 12);    // requires (chunksize % 16 == 0)
+static const size_t max_chunksize = (1 << 20); // largest step grow_step grows the heap by
 
 static const word_t alloc_mask = 0x1;
+static const word_t prev_alloc_mask = 0x2;   // allocation bit of the previous block
+static const word_t prev_mini_mask = 0x4;    // set if the previous block is a mini block
 static const word_t size_mask = ~(word_t)0xF;
 
+/*
+ * Number of segregated free lists.  List i holds the free blocks whose size
+ * lies in [2*dsize << i, 2*dsize << (i+1)), up to the size where free
+ * blocks go into the size-ordered tree instead.  With COMPACT_LINKS, free
+ * mini blocks are on list 0 as well.
+ */
+#define SEG_LISTS 5
+static const size_t tree_min_size = (1 << 10); // free blocks this big are kept in the tree
+
+/*
+ * TLSF size classes.  The first level splits sizes by power of two, the
+ * second level splits each power of two into TLSF_SL_COUNT equal ranges.
+ * Blocks below TLSF_SMALL_SIZE all share first level 0, whose second level
+ * steps by dsize, so every small size has a class of its own.
+ */
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + 4)
+#define TLSF_SMALL_SIZE (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT 25
+
+/*
+ * Requests of at least map_threshold bytes get pages of their own instead of
+ * growing the heap, which can never give the space back.
+ */
+static const size_t map_threshold = (1 << 17);
+
+/*
+ * calloc clears blocks of at least stream_threshold bytes with non-temporal
+ * stores, which do not pull the whole block through the cache.
+ */
+static const size_t stream_threshold = (1 << 16);
+
+/*
+ * Quick list i holds blocks of exactly (i + 1) * dsize bytes whose free was
+ * deferred.  They keep their allocated header, so nothing coalesces with
+ * them until they are flushed.
+ */
+#define QUICK_LISTS 64
+static const size_t quick_max_size = QUICK_LISTS * 2*sizeof(uint64_t); // largest block put on a quick list
+
+/*
+ * Buddy orders.  A block of order k is (1 << k) bytes long and starts at a
+ * multiple of that from heap_start.  The smallest order holds a header and
+ * both list links; the largest covers all of MAX_DENSE_HEAP.
+ */
+#define BUDDY_MIN_ORDER 5
+#define BUDDY_MAX_ORDER 27
+
+/*
+ * Requests of up to slab_max_size bytes are served from slabs: heap blocks
+ * of slab_page_size bytes whose payload starts on a page boundary, each cut
+ * into objects of one size class.  Objects have no header; a bit in slab_map
+ * tells free that a page holds a slab, and the slab_t at the start of the
+ * page has a bitmap of its free objects.
+ */
+#define SLAB_CLASSES 8
+#define SLAB_MAP_WORDS (MAX_DENSE_HEAP / (1 << 12) / 64)
+static const size_t slab_page_size = (1 << 12); // size (and alignment) of a slab page
+static const size_t slab_max_size = SLAB_CLASSES * 2*sizeof(uint64_t); // largest request served by a slab
+
+/*
+ * A thread's cache of slab objects, by slab class.  The objects still
+ * count as used in their slabs; they are only handed out again by the
+ * thread that holds them.
+ */
+#define TCACHE_SIZE 32
+
+typedef struct
+{
+    unsigned long generation;               // heap_generation the objects were taken from
+    unsigned int count[SLAB_CLASSES];       // objects held for each class
+    void *objects[SLAB_CLASSES][TCACHE_SIZE];
+} tcache_t;
+
+typedef struct slab
+{
+    struct slab *previous;    // partial slabs of the same class
+    struct slab *next;
+    size_t object_size;       // size of every object in the slab
+    unsigned int used;        // number of objects handed out
+    unsigned int capacity;    // number of objects that fit in the page
+    unsigned long free_map[4]; // bit i is set if object i is free
+} slab_t;
+
+/*
+ * A free list link: a pointer, or with COMPACT_LINKS the block's offset
+ * from link_base, where 0 stands for NULL since no free block starts there.
+ */
+#if COMPACT_LINKS
+typedef uint32_t link_t;
+#else
+typedef struct block *link_t;
+#endif
+
 typedef struct block
 {
-    /* Header contains size + allocation flag */
+    /* Header contains size + previous block mini/allocation flags + allocation flag */
     word_t header;
     union{
+        /* Free blocks on a list; use get_next and friends to follow them */
         struct{
-            struct block* previous;
-            struct block* next;
+            link_t previous;
+            link_t next;
+        };
+        /* A free mini block only has room for the link of a singly linked list */
+        struct block* mini_next;
+        /* A block on a quick list is linked through its first payload word */
+        struct block* quick_next;
+        /* Large free blocks are nodes of a splay tree ordered by (size, address) */
+        struct{
+            struct block* left;
+            struct block* right;
+            struct block* parent;
         };
     
     /*
@@ -96,23 +367,123 @@ typedef struct block
 } block_t;
 
 
+/*
+ * Event counts of an arena for mm_get_stats, only kept if MM_STATS is set.
+ * They are written with the arena's lock held, and take up cache lines of
+ * their own, so that counting never contends with another arena.
+ */
+typedef struct
+{
+    size_t splits;          // free blocks split by place or split_allocated
+    size_t coalesces;       // merges of a free block with a neighbour
+    size_t fit_calls;       // calls to find_fit
+    size_t fit_probes;      // free blocks those calls looked at
+    size_t fit_probes_max;  // most free blocks one call looked at
+    size_t extends;         // calls to extend_heap that grew the heap
+} __attribute__((aligned(64))) counters_t;
+
+/*
+ * An arena is a heap of its own, grown in one memlib region, with its own
+ * free lists and lock.
+ */
+typedef struct
+{
+    pthread_mutex_t mutex;   // held while the arena is touched
+    int region;              // memlib region the heap lives in
+    /* Pointer to first block */
+    block_t *heap_start;
+    block_t *seg_list[SEG_LISTS]; // heads of the segregated free lists
+    block_t *mini_list;           // head of the singly linked list of free mini blocks
+    block_t *tree_root;           // root of the tree of free blocks of at least tree_min_size
+
+    unsigned long tlsf_fl_bitmap;                // bit fl set if any list on first level fl is non-empty
+    unsigned long tlsf_sl_bitmap[TLSF_FL_COUNT]; // bit sl set if tlsf_list[fl][sl] is non-empty
+    block_t *tlsf_list[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+    block_t *seg_rover[SEG_LISTS]; // where the next next-fit search of each list starts, or NULL for its head
+
+    block_t *quick_list[QUICK_LISTS];  // deferred frees, by exact block size
+
+    block_t *buddy_list[BUDDY_MAX_ORDER + 1]; // free blocks of each buddy order
+    unsigned long buddy_bitmap;                // bit k set if buddy_list[k] is non-empty
+
+    slab_t *slab_partial[SLAB_CLASSES];   // slabs with at least one free object, per class
+
+    void *remote_list;       // payloads freed by threads of other arenas, linked through their first word
+
+    char *fresh;             // where the zero memory added by the last extend_heap starts
+    size_t grow_size;        // least the heap grows by next time, between chunksize and max_chunksize
+
+    counters_t counters;     // what mm_get_stats reports, if MM_STATS is set
+} arena_t;
+
 /* Global variables */
-/* Pointer to first block */
-static block_t *heap_start;
-static block_t *list_start; // pointer to list of free blocks
-//static block_t *list_end;
+const bool mm_thread_safe = THREADS;         // may the allocator be called from several threads at once?
+static arena_t arenas[ARENAS] = {[0 ... ARENAS - 1] = {.mutex = PTHREAD_MUTEX_INITIALIZER}};
+static __thread arena_t *arena = &arenas[0]; // the arena being worked on; its lock is held
+static __thread arena_t *home_arena;         // the arena the calling thread allocates from
+static unsigned int arena_next;              // arena for the next thread to be assigned one
+static char *link_base;                      // mem_heap_lo, which compact links are offsets from
+
+static mm_insert_policy_t insert_policy = MM_INSERT_LIFO; // how free blocks enter the segregated lists
+static mm_insert_policy_t next_insert_policy = MM_INSERT_LIFO; // insert_policy from the next mm_init on
+static mm_fit_policy_t fit_policy = MM_FIT_FIRST;         // how find_fit searches the segregated lists
+static size_t fit_scan_limit = 8;                         // fitting blocks a good-fit search looks at
+
+static unsigned long slab_map[SLAB_MAP_WORDS]; // bit set for every heap page that holds a slab
+
+static pthread_mutex_t map_mutex = PTHREAD_MUTEX_INITIALIZER; // held while memlib's mapped regions change
+static unsigned long heap_generation = 1;     // bumped by mm_init, so caches of an old heap are dropped
+static __thread tcache_t tcache;              // this thread's cache of slab objects
+static pthread_key_t tcache_key;              // its destructor flushes a thread's cache when it exits
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
 
 bool mm_checkheap(int lineno);
 
 /* Function prototypes for internal helper routines */
+static void *heap_malloc(size_t size);
+static void heap_free(void *bp);
+static void *heap_realloc(void *ptr, size_t size);
+static bool fits_in_place(void *bp, size_t size);
+static void stats_count_free(struct mm_stats *stats, size_t size);
+static bool arena_init(void);
+static bool arena_ready(void);
+static bool arena_trim(size_t pad);
+static arena_t *arena_home(void);
+static arena_t *arena_of(void *bp);
+static void arena_lock(arena_t *a);
+static void arena_unlock(void);
+static void remote_push(arena_t *owner, void *bp);
+static void remote_drain(void);
+static tcache_t *tcache_get(void);
+static void *tcache_malloc(size_t size);
+static void tcache_free(int index, void *bp);
+static void tcache_flush(tcache_t *cache, int index, unsigned int keep);
+static void tcache_release(void *cache);
+static void tcache_key_create(void);
 static block_t *extend_heap(size_t size);
+static block_t *grow_heap(size_t asize);
+static size_t grow_step(size_t size);
+static void clear_block(void *bp, size_t size, char *fresh);
+static void clear(void *p, size_t size);
 static void place(block_t *block, size_t asize);
+static void split_allocated(block_t *block, size_t asize);
+static bool grow_in_place(block_t *block, size_t asize);
+static size_t adjust_size(size_t size);
+static block_t *alloc_aligned(size_t asize, size_t align);
+static size_t aligned_lead(block_t *block, size_t align);
 static block_t *find_fit(size_t asize);
+static block_t *search_fit(size_t asize);
+static block_t *next_fit(int index, size_t asize);
+static block_t *good_fit(int index, size_t asize);
 static block_t *coalesce(block_t *block);
+static void free_block(block_t *block);
+static int compare_address(const void *a, const void *b);
+static bool quick_flush(void);
 
 static size_t max(size_t x, size_t y);
 static size_t round_up(size_t size, size_t n);
-static word_t pack(size_t size, bool alloc);
+static word_t pack(size_t size, bool prev_alloc, bool prev_mini, bool alloc);
 
 static size_t extract_size(word_t header);
 static size_t get_size(block_t *block);
@@ -120,9 +491,12 @@ static size_t get_payload_size(block_t *block);
 
 static bool extract_alloc(word_t header);
 static bool get_alloc(block_t *block);
+static bool get_prev_alloc(block_t *block);
+static bool get_prev_mini(block_t *block);
 
-static void write_header(block_t *block, size_t size, bool alloc);
+static void write_header(block_t *block, size_t size, bool prev_alloc, bool prev_mini, bool alloc);
 static void write_footer(block_t *block, size_t size, bool alloc);
+static void write_next_prev_bits(block_t *block);
 
 static block_t *payload_to_header(void *bp);
 static void *header_to_payload(block_t *block);
@@ -131,23 +505,112 @@ static block_t *find_next(block_t *block);
 static word_t *find_prev_footer(block_t *block);
 static block_t *find_prev(block_t *block);
 
+static block_t *get_next(block_t *block);
+static block_t *get_previous(block_t *block);
+static void set_next(block_t *block, block_t *next);
+static void set_previous(block_t *block, block_t *previous);
+
 /* My function prototypes */
-static void remove_block(block_t *block);
+static block_t *remove_block(block_t *block);
 static void insert_at_front(block_t *block);
+static void insert_free(block_t *block, block_t *hint);
+static int find_list_index(size_t size);
+static void tree_insert(block_t *block);
+static void tree_remove(block_t *block);
+static block_t *tree_find_fit(size_t asize);
+static bool tree_less(block_t *a, block_t *b);
+static void tree_left_rotate(block_t *x);
+static void tree_right_rotate(block_t *x);
+static void tree_splay(block_t *x);
+static void tree_replace(block_t *u, block_t *v);
+static block_t *tree_minimum(block_t *u);
+static void tlsf_mapping(size_t size, int *fl, int *sl);
+static void tlsf_insert(block_t *block);
+static void tlsf_remove(block_t *block);
+static block_t *tlsf_find_fit(size_t asize);
+static void *map_malloc(size_t size);
+static void map_free(block_t *block);
+static bool is_mapped(void *bp);
+static void *buddy_malloc(size_t size);
+static void buddy_free(block_t *block);
+static void *buddy_realloc(void *ptr, size_t size);
+static void *buddy_memalign(size_t alignment, size_t size);
+static block_t *buddy_header(void *bp);
+static bool buddy_grow(int order);
+static int buddy_order(size_t size);
+static block_t *buddy_of(block_t *block);
+static void buddy_insert(block_t *block);
+static void buddy_remove(block_t *block);
+static void *slab_malloc(size_t size);
+static void slab_free(slab_t *slab, void *bp);
+static slab_t *slab_new(int index);
+static void slab_release(slab_t *slab);
+static slab_t *find_slab(void *bp);
+static size_t slab_page_number(void *bp);
+static char *slab_objects(slab_t *slab);
+static void slab_push(int index, slab_t *slab);
+static void slab_unlink(int index, slab_t *slab);
 static void checkblock(block_t *block);
+static void checklists(size_t free_blocks);
+static size_t checktree(block_t *node, block_t *parent);
+static void checkslabs(void);
+static size_t checkquick(void);
+static bool checkbuddy(int line);
 static int alignment(block_t *block);
-//static int in_heap(block_t *block);
+static int in_heap(block_t *block);
 
 
 /*
  * <what does mm_init do?>
  * this function initializes the memory. How big is the heap? The fuction uses mem_sbrk() function to allocate
  * a 16 bytes - data segment.
+ * With several arenas, each gets a region of the heap; only the calling
+ * thread's arena is set up now, and the others when first used.
  */
 bool mm_init(void) 
 {
+    if (ARENAS > 1 && mem_set_regions(ARENAS) < 0)
+    {
+        return false;
+    }
+    for (int i = 0; i < ARENAS; i++)
+    {
+        arenas[i].region = i;
+        arenas[i].heap_start = NULL;
+        arenas[i].remote_list = NULL;
+        memset(&arenas[i].counters, 0, sizeof(arenas[i].counters));
+    }
+    memset(slab_map, 0, sizeof(slab_map));
+    link_base = mem_heap_lo();
+    insert_policy = next_insert_policy;
+    __atomic_fetch_add(&heap_generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&arena_next, 1, __ATOMIC_RELAXED);
+
+    home_arena = arena = &arenas[0];
+    return arena_init();
+}
+
+/*
+ * arena_init: sets up an empty heap in the arena being worked on.
+ */
+static bool arena_init(void)
+{
+    if (BUDDY)
+    {
+        // One word of padding puts every buddy block's payload on a 16-byte boundary
+        word_t *pad = (word_t *)(mem_region_sbrk(arena->region, wsize));
+        if (pad == (void *)-1)
+        {
+            return false;
+        }
+        arena->heap_start = (block_t *) &(pad[1]);
+        memset(arena->buddy_list, 0, sizeof(arena->buddy_list));
+        arena->buddy_bitmap = 0;
+        return true;
+    }
+
     // Create the initial empty heap 
-    word_t *start = (word_t *)(mem_sbrk(2*wsize));
+    word_t *start = (word_t *)(mem_region_sbrk(arena->region, 2*wsize));
 
     /*
      * This condition checks if the pointer of the prologue is the same as it of the epilogue 
@@ -159,13 +622,25 @@ bool mm_init(void)
         return false;
     }
 
-    start[0] = pack(0, true); // Prologue footer
-    start[1] = pack(0, true); // Epilogue header
+    start[0] = pack(0, false, false, true); // Prologue footer
+    start[1] = pack(0, true, false, true); // Epilogue header, preceded by the allocated prologue
     // Heap starts with first "block header", currently the epilogue footer
-    heap_start = (block_t *) &(start[1]);
+    arena->heap_start = (block_t *) &(start[1]);
 
-    // list_start points to NULL because there is nothing in the doubly linked list
-    list_start = NULL;
+    // Every segregated list is empty because there are no free blocks yet
+    for (int i = 0; i < SEG_LISTS; i++)
+    {
+        arena->seg_list[i] = NULL;
+        arena->seg_rover[i] = NULL;
+    }
+    arena->mini_list = NULL;
+    arena->tree_root = NULL;
+    arena->tlsf_fl_bitmap = 0;
+    memset(arena->tlsf_sl_bitmap, 0, sizeof(arena->tlsf_sl_bitmap));
+    memset(arena->tlsf_list, 0, sizeof(arena->tlsf_list));
+    memset(arena->quick_list, 0, sizeof(arena->quick_list));
+    memset(arena->slab_partial, 0, sizeof(arena->slab_partial));
+    arena->grow_size = chunksize;
 
     // Extend the empty heap with a free block of chunksize bytes
     if (extend_heap(chunksize) == NULL)
@@ -176,262 +651,2194 @@ bool mm_init(void)
 }
 
 /*
- * <what does mmalloc do?>
- * 
+ * mm_trim: shrinks the heap when its last block is free, keeping pad bytes
+ *          of that block (at least a regular block's worth, unless pad is
+ *          zero) and returning the rest to memlib.  Deferred frees are
+ *          flushed first, since one may be sitting at the top.  Returns
+ *          true if the heap shrank.  The buddy engine does not trim, as its
+ *          top block may be pinned in place by its alignment.  Every arena
+ *          is trimmed in turn.
  */
-void *malloc(size_t size) 
+bool mm_trim(size_t pad)
 {
-    dbg_requires(mm_checkheap(__LINE__));
-    size_t asize;      // Adjusted block size
-    size_t extendsize; // Amount to extend heap if no fit is found
-    block_t *block;
-    void *bp = NULL;
-
-    if (heap_start == NULL) // Initialize heap if it isn't initialized
-    {
-        mm_init();
-    }
+    arena_t *current = arena;
+    bool trimmed = false;
 
-    if (size == 0) // Ignore spurious request
+    for (int i = 0; i < ARENAS && !BUDDY; i++)
     {
-        dbg_ensures(mm_checkheap(__LINE__));
-        return bp;
+        arena_lock(&arenas[i]);
+        if (arena->heap_start != NULL && arena_trim(pad))
+        {
+            trimmed = true;
+        }
+        arena_unlock();
     }
+    arena = current;
+    return trimmed;
+}
 
-    // Adjust block size to include overhead and to meet alignment requirements
-    asize = round_up(size + dsize, dsize);
-
-    // Search the free list for a fit
-    block = find_fit(asize);
+/*
+ * mm_get_stats: fills in stats for all arenas.  Live and free bytes and
+ *               the free blocks per size class come from a walk of each
+ *               heap, so they are always there.  The event counts are only
+ *               kept when MM_STATS is set, and are 0 otherwise, in which
+ *               case false is returned.  Blocks waiting on a quick list
+ *               count as free, and a slab counts the objects in use as
+ *               live; blocks in a thread's cache are counted as live.
+ */
+bool mm_get_stats(struct mm_stats *stats)
+{
+    arena_t *current = arena;
+    size_t fit_probes = 0;
 
-    // If no fit is found, request more memory, and then and place the block
-    if (block == NULL)
-    {  
-        extendsize = max(asize, chunksize);
-        block = extend_heap(extendsize);
-        if (block == NULL) // extend_heap returns an error
+    memset(stats, 0, sizeof(*stats));
+    stats->live_bytes = mem_mapsize();
+    for (int i = 0; i < ARENAS; i++)
+    {
+        arena_lock(&arenas[i]);
+        for (block_t *block = arena->heap_start;
+             block != NULL && (void *)block <= mem_region_hi(arena->region) && get_size(block) != 0;
+             block = find_next(block))
         {
-            return bp;
+            size_t size = get_size(block);
+            slab_t *slab = (BUDDY || !get_alloc(block)) ? NULL : find_slab(header_to_payload(block));
+            if (slab != NULL)
+            {
+                stats->live_bytes += slab->used * slab->object_size;
+            }
+            else if (get_alloc(block))
+            {
+                stats->live_bytes += get_payload_size(block);
+            }
+            else
+            {
+                stats->free_bytes += size;
+                stats_count_free(stats, size);
+            }
+        }
+        for (int index = 0; DEFER_COALESCE && index < QUICK_LISTS; index++)
+        {
+            for (block_t *block = arena->quick_list[index]; block != NULL; block = block->quick_next)
+            {
+                stats->live_bytes -= get_payload_size(block);
+                stats->free_bytes += get_size(block);
+                stats_count_free(stats, get_size(block));
+            }
         }
 
+        stats->splits += arena->counters.splits;
+        stats->coalesces += arena->counters.coalesces;
+        stats->fit_calls += arena->counters.fit_calls;
+        fit_probes += arena->counters.fit_probes;
+        stats->fit_probes_max = max(stats->fit_probes_max, arena->counters.fit_probes_max);
+        stats->extend_calls += arena->counters.extends;
+        arena_unlock();
     }
+    arena = current;
 
-    place(block, asize);
-    bp = header_to_payload(block);
+    stats->fit_probes_mean = (stats->fit_calls == 0) ? 0.0 : (double)fit_probes / stats->fit_calls;
+    return MM_STATS;
+}
 
-    dbg_ensures(mm_checkheap(__LINE__));
-    return bp;
-} 
+/*
+ * stats_count_free: counts a free block of the given size in its size
+ *                   class of stats.
+ */
+static void stats_count_free(struct mm_stats *stats, size_t size)
+{
+    int index = (63 - __builtin_clzl(size)) - (63 - __builtin_clzl(dsize));
+    stats->free_blocks[(index < MM_STATS_CLASSES) ? index : MM_STATS_CLASSES - 1]++;
+}
 
 /*
- * <what does free do?>
+ * arena_ready: makes sure the arena being worked on has a heap, setting it
+ *              up if mm_init left it for later.  A first arena without a
+ *              heap means mm_init was never called, so it is called now.
+ *              Returns false if there is no memory for the heap.
  */
-void free(void *bp)
+static bool arena_ready(void)
 {
-    if (bp == NULL)
+    if (arena->heap_start != NULL)
     {
-        return;
+        return true;
     }
-
-    block_t *block = payload_to_header(bp);
-    size_t size = get_size(block);
-
-    write_header(block, size, false);
-    write_footer(block, size, false);
-
-    coalesce(block);
-
+    return (arena == &arenas[0]) ? mm_init() : arena_init();
 }
 
 /*
- * <what does realloc do?>
+ * arena_trim: does the work of mm_trim for the arena being worked on.
  */
-void *realloc(void *ptr, size_t size)
+static bool arena_trim(size_t pad)
 {
-    block_t *block = payload_to_header(ptr);
-    size_t copysize;
-    void *newptr;
+    quick_flush();
 
-    // If size == 0, then free block and return NULL
-    if (size == 0)
+    block_t *epilogue = payload_to_header((char *)mem_region_hi(arena->region) + 1);
+    if (get_prev_alloc(epilogue))
     {
-        free(ptr);
-        return NULL;
+        return false;
     }
-
-    // If ptr is NULL, then equivalent to malloc
-    if (ptr == NULL)
+    block_t *block = find_prev(epilogue);
+    size_t size = get_size(block);
+    size_t keep = (pad == 0) ? 0 : max(round_up(pad, dsize), min_block_size);
+    if (keep >= size)
     {
-        return malloc(size);
+        return false;
     }
 
-    // Otherwise, proceed with reallocation
-    newptr = malloc(size);
-    // If malloc fails, the original block is left untouched
-    if (newptr == NULL)
+    remove_block(block);
+    if (keep == 0)
     {
-        return NULL;
+        // The block's header becomes the new epilogue
+        write_header(block, 0, get_prev_alloc(block), get_prev_mini(block), true);
     }
-
-    // Copy the old data
-    copysize = get_payload_size(block); // gets size of old payload
-    if(size < copysize)
+    else
     {
-        copysize = size;
+        write_header(block, keep, get_prev_alloc(block), get_prev_mini(block), false);
+        write_footer(block, keep, false);
+        write_header(find_next(block), 0, false, keep == mini_block_size, true);
+        insert_free(block, NULL);
     }
-    memcpy(newptr, ptr, copysize);
-
-    // Free the old block
-    free(ptr);
+    mem_region_trim(arena->region, size - keep);
+    arena->grow_size = chunksize;
 
-    return newptr;
+    dbg_ensures(mm_checkheap(__LINE__));
+    return true;
 }
 
 /*
- * <what does calloc do?>
+ * malloc: in a thread-safe build, small requests come from the calling
+ *         thread's cache without taking a lock.  Everything else is
+ *         served from the thread's arena with its lock held.
  */
-void *calloc(size_t elements, size_t size)
+void *malloc(size_t size)
 {
-    void *bp;
-    size_t asize = elements * size;
-
-    if (asize/elements != size)
-    {    
-        // Multiplication overflowed
-        return NULL;
-    }
-    
-    bp = malloc(asize);
-    if (bp == NULL)
+    if (THREADS && !BUDDY && size != 0 && size <= slab_max_size)
     {
-        return NULL;
+        return tcache_malloc(size);
     }
-    // Initialize all bits to 0
-    memset(bp, 0, asize);
-
+    arena_lock(arena_home());
+    void *bp = heap_malloc(size);
+    arena_unlock();
     return bp;
 }
 
-/******** The remaining content below are helper and debug routines ********/
-
 /*
- * <what does extend_heap do?>
+ * free: in a thread-safe build, a slab object goes into the calling
+ *       thread's cache without taking the lock.  Whether bp is a slab
+ *       object is read from slab_map, which only changes for pages with
+ *       no objects out, so the bit for bp's page is stable.  Anything
+ *       outside the heap's reservation is a mapped block.  A block of
+ *       another thread's arena is queued for that arena without taking
+ *       its lock; the calling thread's own blocks are freed at once.
  */
-static block_t *extend_heap(size_t size) 
+void free(void *bp)
 {
-    void *bp;
+    if (THREADS && !BUDDY && bp != NULL
+        && (size_t)((char *)bp - (char *)mem_heap_lo()) < MAX_DENSE_HEAP)
+    {
+        slab_t *slab = find_slab(bp);
+        if (slab != NULL)
+        {
+            tcache_free(slab->object_size / dsize - 1, bp);
+            return;
+        }
+    }
+    arena_t *owner = arena_of(bp);
+    if (THREADS && owner != arena_home())
+    {
+        remote_push(owner, bp);
+        return;
+    }
+    arena_lock(owner);
+    heap_free(bp);
+    arena_unlock();
+}
 
-    // Allocate an even number of words to maintain alignment
-    size = round_up(size, dsize);
-    if ((bp = mem_sbrk(size)) == (void *)-1)
+/*
+ * mm_free_sized: frees bp, which was allocated or last reallocated with
+ *                size bytes.  The size gives a slab object's class, so in
+ *                a thread-safe build the object goes into the thread's
+ *                cache without reading its slab's header.  Everything else
+ *                is freed as by free.  Debug builds check the size against
+ *                the block.
+ */
+void mm_free_sized(void *bp, size_t size)
+{
+    if (bp == NULL)
     {
-        return NULL;
+        return;
     }
-    
-    // Initialize free block header/footer 
-    block_t *block = payload_to_header(bp);
-    write_header(block, size, false);
-    write_footer(block, size, false);
-    // Create new epilogue header
-    block_t *block_next = find_next(block);
-    write_header(block_next, 0, true);
+    dbg_assert(BUDDY || is_mapped(bp) || find_slab(bp) == NULL
+               ? size <= malloc_usable_size(bp)
+               : size != 0 && (size - 1) / dsize == find_slab(bp)->object_size / dsize - 1);
 
-    // Coalesce in case the previous block was free
-    return coalesce(block);
+    if (THREADS && !BUDDY && size != 0 && size <= slab_max_size && !is_mapped(bp)
+        && find_slab(bp) != NULL)
+    {
+        tcache_free((size - 1) / dsize, bp);
+        return;
+    }
+    free(bp);
 }
 
 /*
- * <what does coalesce do?>
- * To coalesce newly freed block with neighbours, there are 4 cases
- *   [PREVIOUS -- CURRENT -- NEXT]
- *1: [ALLOC    -- FREE    -- ALLOC] : APPEND THE NEW BLOCK TO THE FRONT OF THE LIST
- *2: [ALLOC    -- FREE    -- FREE]  : APPEND NEW BLOCK (CURRENT + NEXT)
- *3: [FREE     -- FREE    -- ALLOC] : APPEND NEW BLOCK (PREVIOUS + CURRENT)
- *4: [FREE     -- FREE    -- FREE]  : APPEND NEW BLOCK (PREVIOUS + CURRENT + NEXT)
+ * realloc: returns ptr at once if the block already fits size bytes with
+ *          nothing to give back, without taking any lock.  Otherwise it
+ *          works in the arena that holds ptr, with its lock held.  A
+ *          mapped block, or none at all, is moved into the calling
+ *          thread's arena.
  */
-static block_t *coalesce(block_t * block) 
+void *realloc(void *ptr, size_t size)
 {
-    // fill me in
-    size_t previous_allocation = get_alloc(find_prev(block)); //store whether the previous block is allocated or not.
-    size_t next_allocation = get_alloc(find_next(block)); //store whether the next block is allocated or not.
-    size_t size = get_size(block); //store the size of a block
-    block_t *block_next;
-    block_t *block_previous;
-
-    //Case 1: The block is next to the current block is free
-    if(previous_allocation && !next_allocation){
-        block_next = find_next(block); //find the next block
-        size += get_size(block_next); // update the size to be the size of the current block + the size of the next block
-        remove_block(block_next); // remove the next block because it is now one block contained next + current
-        write_header(block,size,false); // update header of the new block
-        write_footer(block,size,false); // update footer of the new block
-        // no need to update the block pointer because it still needs to pointer to the start of the (current + next) block
+    if (ptr != NULL && size != 0 && fits_in_place(ptr, size))
+    {
+        return ptr;
     }
-    //Case 2: The block is previous to the current block is free
-    else if(!previous_allocation && next_allocation && find_prev(block) != block){
-        block_previous = find_prev(block); //find the block pointer
+    arena_lock(arena_of(ptr));
+    void *newptr = heap_realloc(ptr, size);
+    arena_unlock();
+    return newptr;
+}
+
+/*
+ * malloc_usable_size: returns how many bytes the block at bp can hold,
+ *                     which may be more than were asked for.  NULL holds
+ *                     nothing.
+ */
+size_t malloc_usable_size(void *bp)
+{
+    if (bp == NULL)
+    {
+        return 0;
+    }
+    // A mapped block's payload starts a word after its header
+    if (is_mapped(bp))
+    {
+        return get_size(payload_to_header(bp)) - dsize;
+    }
+    // An aligned buddy payload may start anywhere in its block
+    if (BUDDY)
+    {
+        block_t *block = buddy_header(bp);
+        return (char *)block + get_size(block) - (char *)bp;
+    }
+    slab_t *slab = find_slab(bp);
+    if (slab != NULL)
+    {
+        return slab->object_size;
+    }
+    return get_payload_size(payload_to_header(bp));
+}
+
+/*
+ * fits_in_place: returns true if realloc can leave the block at bp as it
+ *                is for a new size of size bytes.  The size must fit in the
+ *                block's usable space, and the slack must be too small to
+ *                give back: for a heap block, too small to split off, for a
+ *                slab object, less than a step to a smaller class, and for
+ *                a mapped block, the size must still want its own region.
+ *                Reads nothing but the caller's own block, so needs no lock.
+ */
+static bool fits_in_place(void *bp, size_t size)
+{
+    // adjust_size would wrap around for sizes near SIZE_MAX
+    if (size > MAX_DENSE_HEAP - dsize || size > malloc_usable_size(bp))
+    {
+        return false;
+    }
+    if (is_mapped(bp))
+    {
+        return size >= map_threshold;
+    }
+    if (BUDDY)
+    {
+        return false;
+    }
+    slab_t *slab = find_slab(bp);
+    if (slab != NULL)
+    {
+        return size > slab->object_size - dsize;
+    }
+    return get_size(payload_to_header(bp)) - adjust_size(size) < smallest_block_size;
+}
+
+/*
+ * <what does mmalloc do?>
+ * heap_malloc, heap_free and heap_realloc do the work of malloc, free and
+ * realloc on the arena being worked on; the caller holds its lock.
+ */
+static void *heap_malloc(size_t size) 
+{
+    dbg_requires(mm_checkheap(__LINE__));
+    size_t asize;      // Adjusted block size
+    block_t *block;
+    void *bp = NULL;
+
+    if (!arena_ready()) // Initialize heap if it isn't initialized
+    {
+        return NULL;
+    }
+
+    if (size == 0) // Ignore spurious request
+    {
+        dbg_ensures(mm_checkheap(__LINE__));
+        return bp;
+    }
+
+    // Large requests get a mapped region of their own
+    if (size >= map_threshold)
+    {
+        bp = map_malloc(size);
+        dbg_ensures(mm_checkheap(__LINE__));
+        return bp;
+    }
+
+    if (BUDDY)
+    {
+        bp = buddy_malloc(size);
+        dbg_ensures(mm_checkheap(__LINE__));
+        return bp;
+    }
+
+    // Small requests are carved out of a slab
+    if (size <= slab_max_size)
+    {
+        bp = slab_malloc(size);
+        dbg_ensures(mm_checkheap(__LINE__));
+        return bp;
+    }
+
+    // Sizes near SIZE_MAX would wrap around in adjust_size
+    if (size > MAX_DENSE_HEAP - dsize)
+    {
+        return NULL;
+    }
+
+    // Adjust block size to include the header and to meet alignment requirements
+    asize = adjust_size(size);
+
+    // A deferred free of the same size is taken back as is
+    if (DEFER_COALESCE && asize <= quick_max_size && arena->quick_list[asize / dsize - 1] != NULL)
+    {
+        block = arena->quick_list[asize / dsize - 1];
+        arena->quick_list[asize / dsize - 1] = block->quick_next;
+        bp = header_to_payload(block);
+        dbg_ensures(mm_checkheap(__LINE__));
+        return bp;
+    }
+
+    // Search the free list for a fit, flushing the quick lists if there is none
+    block = find_fit(asize);
+    if (block == NULL && quick_flush())
+    {
+        block = find_fit(asize);
+    }
+
+    // If no fit is found, request more memory, and then and place the block
+    if (block == NULL)
+    {  
+        block = grow_heap(asize);
+        if (block == NULL) // extend_heap returns an error
+        {
+            return bp;
+        }
+
+    }
+
+    place(block, asize);
+    bp = header_to_payload(block);
+
+    dbg_ensures(mm_checkheap(__LINE__));
+    return bp;
+} 
+
+/*
+ * <what does free do?>
+ */
+static void heap_free(void *bp)
+{
+    if (bp == NULL)
+    {
+        return;
+    }
+
+    if (is_mapped(bp))
+    {
+        map_free(payload_to_header(bp));
+        return;
+    }
+
+    if (BUDDY)
+    {
+        buddy_free(buddy_header(bp));
+        return;
+    }
+
+    slab_t *slab = find_slab(bp);
+    if (slab != NULL)
+    {
+        slab_free(slab, bp);
+        return;
+    }
+
+    block_t *block = payload_to_header(bp);
+
+    // Small blocks wait on a quick list, still marked allocated
+    if (DEFER_COALESCE && get_size(block) <= quick_max_size)
+    {
+        block->quick_next = arena->quick_list[get_size(block) / dsize - 1];
+        arena->quick_list[get_size(block) / dsize - 1] = block;
+        return;
+    }
+
+    free_block(block);
+}
+
+/*
+ * <what does realloc do?>
+ * Resizes the block in place whenever it can:
+ *   - a smaller size splits the unused tail off as a free block,
+ *   - a larger size absorbs the next block if it is free and big enough,
+ *   - a block at the top of the heap grows by extending the heap.
+ * Only when none of these apply does it malloc a new block, copy the
+ * payload and free the old one.
+ */
+static void *heap_realloc(void *ptr, size_t size)
+{
+    block_t *block = payload_to_header(ptr);
+    size_t asize;
+    size_t copysize;
+    void *newptr;
+
+    // If size == 0, then free block and return NULL
+    if (size == 0)
+    {
+        heap_free(ptr);
+        return NULL;
+    }
+
+    // If ptr is NULL, then equivalent to malloc
+    if (ptr == NULL)
+    {
+        return heap_malloc(size);
+    }
+
+    // A mapped block stays put while the new size still needs its own region
+    if (is_mapped(ptr))
+    {
+        copysize = get_size(block) - dsize;
+        if (size >= map_threshold && size <= copysize)
+        {
+            return ptr;
+        }
+        newptr = heap_malloc(size);
+        if (newptr == NULL)
+        {
+            return NULL;
+        }
+        memcpy(newptr, ptr, (size < copysize) ? size : copysize);
+        heap_free(ptr);
+        return newptr;
+    }
+
+    if (BUDDY)
+    {
+        return buddy_realloc(ptr, size);
+    }
+
+    // A slab object can only stay put if the new size is in the same class
+    slab_t *slab = find_slab(ptr);
+    if (slab != NULL)
+    {
+        if (size <= slab->object_size && size > slab->object_size - dsize)
+        {
+            return ptr;
+        }
+        newptr = heap_malloc(size);
+        if (newptr == NULL)
+        {
+            return NULL;
+        }
+        memcpy(newptr, ptr, (size < slab->object_size) ? size : slab->object_size);
+        heap_free(ptr);
+        return newptr;
+    }
+
+    // No heap block can be this big, and adjust_size would wrap around
+    if (size > MAX_DENSE_HEAP - dsize)
+    {
+        return NULL;
+    }
+    asize = adjust_size(size);
+
+    // The block is already big enough: give back whatever is left over
+    if (asize <= get_size(block))
+    {
+        split_allocated(block, asize);
+        return ptr;
+    }
+
+    // Try to grow into the next block or the top of the heap
+    if (grow_in_place(block, asize))
+    {
+        return ptr;
+    }
+
+    // Otherwise, proceed with reallocation
+    newptr = heap_malloc(size);
+    // If malloc fails, the original block is left untouched
+    if (newptr == NULL)
+    {
+        return NULL;
+    }
+
+    // Copy the old data
+    copysize = get_payload_size(block); // gets size of old payload
+    if(size < copysize)
+    {
+        copysize = size;
+    }
+    memcpy(newptr, ptr, copysize);
+
+    // Free the old block
+    heap_free(ptr);
+
+    return newptr;
+}
+
+/*
+ * calloc: returns a block of elements * size bytes, all zero.  Memory that
+ *         is known to be zero is not cleared again: a mapped region comes
+ *         zeroed from the system, and a block placed in memory that the
+ *         heap has just grown into is zero but for its free-list links and
+ *         footer.  Small blocks come from slabs and are simply cleared.
+ */
+void *calloc(size_t elements, size_t size)
+{
+    void *bp;
+    size_t asize = elements * size;
+
+    if (elements != 0 && asize/elements != size)
+    {    
+        // Multiplication overflowed
+        return NULL;
+    }
+
+    if (BUDDY || asize <= slab_max_size)
+    {
+        bp = malloc(asize);
+        if (bp == NULL)
+        {
+            return NULL;
+        }
+        // Initialize all bits to 0
+        memset(bp, 0, asize);
+        return bp;
+    }
+
+    arena_lock(arena_home());
+    arena->fresh = NULL;
+    bp = heap_malloc(asize);
+    char *fresh = arena->fresh;
+    arena_unlock();
+    if (bp != NULL && !is_mapped(bp))
+    {
+        clear_block(bp, asize, fresh);
+    }
+    return bp;
+}
+
+/*
+ * memalign: returns a block of size bytes whose payload is aligned to
+ *           alignment bytes, a power of two.  Alignments of up to dsize
+ *           are what malloc gives anyway.  Stricter ones are carved out of
+ *           a free block by alloc_aligned, which frees the leading slack
+ *           again, so nothing is over-allocated.  Such blocks always come
+ *           from the heap, never from a slab or a mapped region.  The buddy
+ *           engine, which cannot split a block off its grid, hands out an
+ *           aligned spot inside a block that is big enough for any.
+ */
+void *memalign(size_t alignment, size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (alignment <= dsize)
+    {
+        return malloc(size);
+    }
+    if (size == 0 || size > MAX_DENSE_HEAP - dsize || alignment > MAX_DENSE_HEAP)
+    {
+        return NULL;
+    }
+
+    void *bp = NULL;
+    arena_lock(arena_home());
+    if (BUDDY && arena_ready())
+    {
+        bp = buddy_memalign(alignment, size);
+    }
+    else if (arena_ready())
+    {
+        block_t *block = alloc_aligned(adjust_size(size), alignment);
+        if (block != NULL)
+        {
+            bp = header_to_payload(block);
+        }
+    }
+    dbg_ensures(mm_checkheap(__LINE__));
+    arena_unlock();
+    return bp;
+}
+
+/*
+ * aligned_alloc: the C11 name for memalign.
+ */
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+/*
+ * posix_memalign: stores a block aligned as memalign would in *memptr.
+ *                 Returns EINVAL if alignment is not a power of two
+ *                 multiple of sizeof(void *), ENOMEM if there is no memory,
+ *                 and 0 otherwise.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    void *bp = memalign(alignment, size);
+    if (bp == NULL && size != 0)
+    {
+        return ENOMEM;
+    }
+    *memptr = bp;
+    return 0;
+}
+
+/*
+ * mm_malloc_batch: allocates n blocks of size bytes each and stores their
+ *                  payloads in out.  Regular heap blocks are carved out of
+ *                  a single fit for all n of them, so the whole batch costs
+ *                  one search and one split.  Requests served by slabs,
+ *                  mapped regions or the buddy engine are made one at a
+ *                  time.  Returns the number of blocks allocated, which is
+ *                  less than n only if memory ran out.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+    size_t asize = adjust_size(size);
+    size_t count = 0;
+
+    if (BUDDY || n < 2 || size <= slab_max_size || size >= map_threshold
+        || asize > MAX_DENSE_HEAP / n)
+    {
+        while (count < n && (out[count] = malloc(size)) != NULL)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    arena_lock(arena_home());
+    if (!arena_ready())
+    {
+        arena_unlock();
+        return 0;
+    }
+
+    block_t *block = find_fit(asize * n);
+    if (block == NULL && quick_flush())
+    {
+        block = find_fit(asize * n);
+    }
+    if (block == NULL)
+    {
+        block = grow_heap(asize * n);
+    }
+    if (block == NULL)
+    {
+        arena_unlock();
+        return 0;
+    }
+    place(block, asize * n);
+
+    // Cut the run into n blocks; the last one keeps any slack place left in it
+    size_t left = get_size(block);
+    for (count = 0; count < n; count++)
+    {
+        size_t bsize = (count == n - 1) ? left : asize;
+        write_header(block, bsize, count > 0 || get_prev_alloc(block), count == 0 && get_prev_mini(block), true);
+        out[count] = header_to_payload(block);
+        left -= bsize;
+        block = find_next(block);
+    }
+
+    dbg_ensures(mm_checkheap(__LINE__));
+    arena_unlock();
+    return count;
+}
+
+/*
+ * mm_free_batch: frees the n payloads in ptrs, which it sorts by address.
+ *                Runs of heap blocks that follow each other in memory are
+ *                first merged into one allocated block, so each run is
+ *                freed and coalesced once instead of block by block.
+ *                Anything else goes through free.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    size_t i = 0;
+
+    qsort(ptrs, n, sizeof(*ptrs), compare_address);
+    while (i < n)
+    {
+        void *bp = ptrs[i];
+        if (BUDDY || bp == NULL || is_mapped(bp) || find_slab(bp) != NULL
+            || (THREADS && arena_of(bp) != arena_home()))
+        {
+            free(bp);
+            i++;
+            continue;
+        }
+
+        // The blocks are the caller's until freed, so their headers can be read without the lock
+        block_t *block = payload_to_header(bp);
+        block_t *end = find_next(block);
+        size_t j = i + 1;
+        while (j < n && ptrs[j] == header_to_payload(end))
+        {
+            end = find_next(end);
+            j++;
+        }
+
+        arena_lock(arena_home());
+        if (j == i + 1)
+        {
+            heap_free(bp);
+        }
+        else
+        {
+            write_header(block, (char *)end - (char *)block, get_prev_alloc(block), get_prev_mini(block), true);
+            free_block(block);
+        }
+        dbg_ensures(mm_checkheap(__LINE__));
+        arena_unlock();
+        i = j;
+    }
+}
+
+/******** The remaining content below are helper and debug routines ********/
+
+/*
+ * <what does extend_heap do?>
+ */
+static block_t *extend_heap(size_t size) 
+{
+    void *bp;
+
+    // No heap gets this big, and mem_region_sbrk takes a signed increment
+    if (size > MAX_DENSE_HEAP)
+    {
+        return NULL;
+    }
+
+    // Allocate an even number of words to maintain alignment
+    size = round_up(size, dsize);
+    char *clean = mem_region_clean(arena->region);
+    if ((bp = mem_region_sbrk(arena->region, size)) == (void *)-1)
+    {
+        return NULL;
+    }
+    // Memory the heap has never held is zero, but for the words written here
+    arena->fresh = ((char *)bp > clean) ? (char *)bp : clean;
+    if (MM_STATS)
+    {
+        arena->counters.extends++;
+    }
+    
+    // Initialize free block header/footer. The header replaces the old epilogue,
+    // which knows whether the last block of the heap is allocated
+    block_t *block = payload_to_header(bp);
+    write_header(block, size, get_prev_alloc(block), get_prev_mini(block), false);
+    write_footer(block, size, false);
+    // Create new epilogue header
+    block_t *block_next = find_next(block);
+    write_header(block_next, 0, false, false, true);
+
+    // Coalesce in case the previous block was free
+    return coalesce(block);
+}
+
+/*
+ * clear_block: zeroes the first size bytes of the payload at bp, skipping
+ *              what is known to be zero already.  If the block was placed
+ *              by a heap_malloc that grew the heap, fresh is where the new
+ *              zero memory started, and is NULL otherwise.  Past fresh, the
+ *              block was only written with the links it had while it was
+ *              free, which lie at the start of its payload, and with its
+ *              footer, which is the last word of the block.
+ */
+static void clear_block(void *bp, size_t size, char *fresh)
+{
+    char *lo = bp;
+    char *hi = lo + size;
+    char *zero = hi; // everything from here up to the footer is zero
+
+    if (fresh != NULL)
+    {
+        zero = ((lo > fresh) ? lo : fresh) + sizeof(block_t) - wsize;
+    }
+    if (zero >= hi)
+    {
+        clear(lo, size);
+        return;
+    }
+    clear(lo, zero - lo);
+
+    block_t *block = payload_to_header(bp);
+    char *footer = (char *)block + get_size(block) - wsize;
+    if (footer < zero)
+    {
+        footer = zero;
+    }
+    if (footer < hi)
+    {
+        clear(footer, hi - footer);
+    }
+}
+
+/*
+ * clear: zeroes size bytes at p.  Ranges of at least stream_threshold bytes
+ *        are written with non-temporal stores where the machine has them,
+ *        so that a large calloc does not evict the whole cache.
+ */
+static void clear(void *p, size_t size)
+{
+#ifdef __SSE2__
+    if (size >= stream_threshold)
+    {
+        char *lo = p;
+        char *hi = lo + size;
+        char *a = (char *)round_up((size_t)lo, 4 * sizeof(__m128i));
+        __m128i zero = _mm_setzero_si128();
+
+        memset(lo, 0, a - lo);
+        for (; a + 4 * sizeof(__m128i) <= hi; a += 4 * sizeof(__m128i))
+        {
+            _mm_stream_si128((__m128i *)a, zero);
+            _mm_stream_si128((__m128i *)a + 1, zero);
+            _mm_stream_si128((__m128i *)a + 2, zero);
+            _mm_stream_si128((__m128i *)a + 3, zero);
+        }
+        _mm_sfence();
+        memset(a, 0, hi - a);
+        return;
+    }
+#endif
+    memset(p, 0, size);
+}
+
+/*
+ * grow_heap: grows the heap until its last block is a free block of at
+ *            least asize bytes, and returns that block.  If the last block
+ *            is free already, the heap only grows by what it lacks, so a
+ *            large request does not leave the old free space unused on top.
+ */
+static block_t *grow_heap(size_t asize)
+{
+    block_t *block_top = payload_to_header((char *)mem_region_hi(arena->region) + 1);
+    size_t available = 0;
+    if (!get_prev_alloc(block_top))
+    {
+        block_top = find_prev(block_top);
+        available = get_size(block_top);
+        if (available >= asize)
+        {
+            return block_top;
+        }
+    }
+    return extend_heap(grow_step(asize - available));
+}
+
+/*
+ * grow_step: returns how much to grow the top of the heap by when size
+ *            more bytes are needed there: size, or the arena's grow_size
+ *            if that is larger.  grow_size doubles with each step, up to
+ *            max_chunksize and a 32nd of the heap, so that sustained
+ *            growth takes ever fewer mem_sbrk calls while what a step
+ *            leaves unused stays small next to the heap.  free_block
+ *            halves it again when frees reach the top of the heap.
+ */
+static size_t grow_step(size_t size)
+{
+    size_t step = max(size, arena->grow_size);
+    size_t heapsize = (char *)mem_region_hi(arena->region) + 1 - (char *)mem_region_lo(arena->region);
+    size_t limit = (heapsize / 32 < max_chunksize) ? heapsize / 32 : max_chunksize;
+
+    if (2 * arena->grow_size <= limit)
+    {
+        arena->grow_size *= 2;
+    }
+    return step;
+}
+
+/*
+ * free_block: marks an allocated block free and coalesces it with its
+ *             neighbours.
+ */
+static void free_block(block_t *block)
+{
+    size_t size = get_size(block);
+
+    write_header(block, size, get_prev_alloc(block), get_prev_mini(block), false);
+    write_footer(block, size, false);
+    write_next_prev_bits(block);
+
+    block = coalesce(block);
+
+    // A free that reaches the top of the heap means the heap has stopped
+    // growing for now, so the next growth step is smaller
+    if (get_size(find_next(block)) == 0 && arena->grow_size > chunksize)
+    {
+        arena->grow_size /= 2;
+    }
+}
+
+/*
+ * compare_address: orders two payload pointers by address, for qsort.
+ */
+static int compare_address(const void *a, const void *b)
+{
+    const char *x = *(const void * const *)a;
+    const char *y = *(const void * const *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * quick_flush: frees every block on the quick lists, coalescing each with
+ *              its neighbours.  Returns false if there was nothing to free.
+ */
+static bool quick_flush(void)
+{
+    bool flushed = false;
+
+    for (int index = 0; DEFER_COALESCE && index < QUICK_LISTS; index++)
+    {
+        while (arena->quick_list[index] != NULL)
+        {
+            block_t *block = arena->quick_list[index];
+            arena->quick_list[index] = block->quick_next;
+            free_block(block);
+            flushed = true;
+        }
+    }
+    return flushed;
+}
+
+/*
+ * <what does coalesce do?>
+ * To coalesce newly freed block with neighbours, there are 4 cases
+ *   [PREVIOUS -- CURRENT -- NEXT]
+ *1: [ALLOC    -- FREE    -- ALLOC] : APPEND THE NEW BLOCK TO THE FRONT OF THE LIST
+ *2: [ALLOC    -- FREE    -- FREE]  : APPEND NEW BLOCK (CURRENT + NEXT)
+ *3: [FREE     -- FREE    -- ALLOC] : APPEND NEW BLOCK (PREVIOUS + CURRENT)
+ *4: [FREE     -- FREE    -- FREE]  : APPEND NEW BLOCK (PREVIOUS + CURRENT + NEXT)
+ */
+static block_t *coalesce(block_t * block) 
+{
+    // fill me in
+    // store whether the previous block is allocated or not. The prologue counts as allocated
+    size_t previous_allocation = get_prev_alloc(block);
+    size_t next_allocation = get_alloc(find_next(block)); //store whether the next block is allocated or not.
+    size_t size = get_size(block); //store the size of a block
+    block_t *block_next;
+    block_t *block_previous;
+    block_t *hint = NULL; // list neighbour of a merged block, where an address-ordered insert can start
+
+    //Case 1: The block is next to the current block is free
+    if(previous_allocation && !next_allocation){
+        block_next = find_next(block); //find the next block
+        size += get_size(block_next); // update the size to be the size of the current block + the size of the next block
+        hint = remove_block(block_next); // remove the next block because it is now one block contained next + current
+        write_header(block,size,true,get_prev_mini(block),false); // update header of the new block
+        write_footer(block,size,false); // update footer of the new block
+        // no need to update the block pointer because it still needs to pointer to the start of the (current + next) block
+    }
+    //Case 2: The block is previous to the current block is free
+    else if(!previous_allocation && next_allocation){
+        block_previous = find_prev(block); //find the block pointer
         size += get_size(block_previous); // update the size to be the sum of the current block and the previous block
-        remove_block(block_previous); // remove the previous block because it is now one block contained previous + current
-        write_header(block_previous,size,false); // update the header of the previous block and set it to be the header
+        hint = remove_block(block_previous); // remove the previous block because it is now one block contained previous + current
+        write_header(block_previous,size,get_prev_alloc(block_previous),get_prev_mini(block_previous),false); // update the header of the previous block and set it to be the header
         write_footer(block_previous,size,false); //update the footer of the current block because the footer location does not change
         block = block_previous; //update the pointer of the block to the previous block as the previous block merged into the current block as one block
     }
-    //Case 3: Both previous and next blocks are free
-    else if(!previous_allocation && !next_allocation && find_prev(block) != block){
-        block_previous = find_prev(block); //find the previous block
-        block_next = find_next(block); //find the next block
-        size += get_size(block_previous) + get_size(block_next); //update the size to be the sum of previous + current + next
-        remove_block(block_next); // remove the next block because it is now one block contained previous + current + next
-        remove_block(block_previous); // remove the previous block because it is now one block contained previous + current + next
-        write_header(block_previous,size,false); //update the the header of the previous block and set it to be the header of the new block
-        write_footer(block_previous,size,false); //update the footer of the next block and set it to be the footer of the new block
-        block = block_previous; //update the pointer of the block to the previous block as previous block and next block merged into the current block
+    //Case 3: Both previous and next blocks are free
+    else if(!previous_allocation && !next_allocation){
+        block_previous = find_prev(block); //find the previous block
+        block_next = find_next(block); //find the next block
+        size += get_size(block_previous) + get_size(block_next); //update the size to be the sum of previous + current + next
+        remove_block(block_next); // remove the next block because it is now one block contained previous + current + next
+        hint = remove_block(block_previous); // remove the previous block because it is now one block contained previous + current + next
+        write_header(block_previous,size,get_prev_alloc(block_previous),get_prev_mini(block_previous),false); //update the the header of the previous block and set it to be the header of the new block
+        write_footer(block_previous,size,false); //update the footer of the next block and set it to be the footer of the new block
+        block = block_previous; //update the pointer of the block to the previous block as previous block and next block merged into the current block
+    }
+    //Case 4: Neither of the previous block and the next block are free
+    if (MM_STATS)
+    {
+        arena->counters.coalesces += !previous_allocation + !next_allocation;
+    }
+    insert_free(block, hint); // add the block to its list under the insertion policy
+    write_next_prev_bits(block); // the next block may no longer follow a mini block
+
+    return block;
+}
+
+// helper function to remove block pointers when coalescing.
+// Returns the block before it on its segregated list, or NULL.
+static block_t *remove_block(block_t *block){
+    if(TLSF){
+        tlsf_remove(block);
+        return NULL;
+    }
+
+    // Mini blocks only know their successor, so walk the mini list to unlink them
+    if(!COMPACT_LINKS && get_size(block) == mini_block_size){
+        block_t **link = &arena->mini_list;
+        while(*link != block){
+            link = &((*link) -> mini_next);
+        }
+        *link = block -> mini_next;
+        return NULL;
+    }
+    if(get_size(block) >= tree_min_size){
+        tree_remove(block);
+        return NULL;
+    }
+
+    int index = find_list_index(get_size(block)); // the list this block was filed under
+
+    // Keep the next-fit rover off the block: the next search starts after it
+    block_t *previous = get_previous(block);
+    block_t *next = get_next(block);
+
+    if(arena->seg_rover[index] == block){
+        arena->seg_rover[index] = next;
+    }
+
+    if(previous != NULL && next != NULL){
+        // how can I get the next pointer of the previous block? Then set it to the next block
+        set_next(previous, next);
+        set_previous(next, previous);
+    }
+    // Case 2: the block is at the tail of the list. There is no block after that to link to
+    else if(previous != NULL && next == NULL)   
+    {
+        set_next(previous, NULL);
+        // no block -> next
+    }
+    // Case 3: The block is at the beginning of the list
+    else if (previous == NULL && next != NULL){
+        set_previous(next, NULL);
+        // update the head of the list to point at the next block
+        arena->seg_list[index] = next;
+    }
+    // Case 4: The block is the only thing in the list
+    else if (previous == NULL && next == NULL){
+        arena->seg_list[index] = NULL;
+    }
+    return previous;
+}
+
+// helper function to insert a block at the front of the list for its size class,
+// or into the tree if it is large
+static void insert_at_front(block_t *block){
+    if(TLSF){
+        tlsf_insert(block);
+        return;
+    }
+
+    if(!COMPACT_LINKS && get_size(block) == mini_block_size){
+        block -> mini_next = arena->mini_list;
+        arena->mini_list = block;
+        return;
+    }
+    if(get_size(block) >= tree_min_size){
+        tree_insert(block);
+        return;
+    }
+
+    int index = find_list_index(get_size(block));
+
+    /* If the free list has nothing, set it the first one*/
+    if(arena->seg_list[index] == NULL){
+        set_next(block, NULL);
+        set_previous(block, NULL);
+        arena->seg_list[index] = block;
+        return;
+    }
+    set_next(block, arena->seg_list[index]); //set the next pointer to point to the head so that the block can be the head of the list
+    set_previous(arena->seg_list[index], block); //set the previous pointer of the old head to block to properly linked
+    set_previous(block, NULL); //set the previous pointer of block to NULL
+    arena->seg_list[index] = block; //set the block to be the start of the list
+}
+
+/*
+ * insert_free: files a free block under the insertion policy.  In address
+ *              order, the search for its place starts at hint if that is a
+ *              lower addressed block on the same list, and at the head of
+ *              the list otherwise.  A hint taken from a block that was just
+ *              merged or split is at most a few steps away.  Mini blocks,
+ *              tree blocks and TLSF classes are not affected by the policy.
+ */
+static void insert_free(block_t *block, block_t *hint)
+{
+    if (TLSF || insert_policy == MM_INSERT_LIFO
+        || (!COMPACT_LINKS && get_size(block) == mini_block_size) || get_size(block) >= tree_min_size)
+    {
+        insert_at_front(block);
+        return;
+    }
+
+    int index = find_list_index(get_size(block));
+    block_t *previous = NULL;
+    block_t *next = arena->seg_list[index];
+
+    if (hint != NULL && hint < block && find_list_index(get_size(hint)) == index)
+    {
+        previous = hint;
+        next = get_next(hint);
+    }
+    while (next != NULL && next < block)
+    {
+        previous = next;
+        next = get_next(next);
+    }
+
+    set_previous(block, previous);
+    set_next(block, next);
+    if (previous != NULL)
+    {
+        set_next(previous, block);
+    }
+    else
+    {
+        arena->seg_list[index] = block;
+    }
+    if (next != NULL)
+    {
+        set_previous(next, block);
+    }
+}
+
+/*
+ * mm_set_insert_policy: chooses how free blocks are put on the segregated
+ *                       lists.  Takes effect from the next mm_init, so
+ *                       that the lists are never mixed.
+ */
+void mm_set_insert_policy(mm_insert_policy_t policy)
+{
+    next_insert_policy = policy;
+}
+
+/*
+ * mm_set_fit_policy: chooses how find_fit searches the segregated lists.
+ *                    The tree always gives the best fit.
+ */
+void mm_set_fit_policy(mm_fit_policy_t policy)
+{
+    fit_policy = policy;
+}
+
+/*
+ * mm_set_fit_scan_limit: sets how many fitting blocks a good-fit search
+ *                        compares before taking the smallest.  A higher
+ *                        limit trades throughput for utilization.
+ */
+void mm_set_fit_scan_limit(size_t limit)
+{
+    fit_scan_limit = (limit == 0) ? 1 : limit;
+}
+
+/*
+ * find_list_index: returns the segregated list that holds free blocks of the
+ *                  given size, i.e. floor(log2(size / (2*dsize))),
+ *                  clamped to the first and last lists.
+ */
+static int find_list_index(size_t size)
+{
+    int index = (63 - __builtin_clzl(size)) - (63 - __builtin_clzl(2*dsize));
+    if (index < 0)
+    {
+        return 0;
+    }
+    return (index < SEG_LISTS) ? index : SEG_LISTS - 1;
+}
+
+/*
+ * tree_insert: adds a free block to the size-ordered tree as a leaf.  Only
+ *              tree_find_fit splays, so freeing and splitting large blocks
+ *              costs no more than the descent.
+ */
+static void tree_insert(block_t *block)
+{
+    block_t *z = arena->tree_root;
+    block_t *p = NULL;
+
+    while (z)
+    {
+        p = z;
+        z = tree_less(block, z) ? z->left : z->right;
+    }
+    block->parent = p;
+    block->left = block->right = NULL;
+    if (!p) arena->tree_root = block;
+    else if (tree_less(block, p)) p->left = block;
+    else p->right = block;
+}
+
+/*
+ * tree_remove: takes a free block out of the size-ordered tree where it is,
+ *              without splaying it first.
+ */
+static void tree_remove(block_t *z)
+{
+    if (!z->left) tree_replace(z, z->right);
+    else if (!z->right) tree_replace(z, z->left);
+    else
+    {
+        block_t *y = tree_minimum(z->right);
+        if (y->parent != z)
+        {
+            tree_replace(y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        tree_replace(z, y);
+        y->left = z->left;
+        y->left->parent = y;
+    }
+}
+
+/*
+ * tree_find_fit: returns the smallest free block in the tree that holds at
+ *                least asize bytes (the lowest addressed one among equals),
+ *                or NULL if there is none.  A block found is splayed to the
+ *                root, which is what keeps the tree balanced in amortized
+ *                terms, and makes taking it out again cheap.
+ */
+static block_t *tree_find_fit(size_t asize)
+{
+    block_t *z = arena->tree_root;
+    block_t *fit = NULL;
+
+    while (z)
+    {
+        if (MM_STATS)
+        {
+            arena->counters.fit_probes++;
+        }
+        if (get_size(z) >= asize)
+        {
+            fit = z;
+            z = z->left;
+        }
+        else
+        {
+            z = z->right;
+        }
+    }
+    if (fit)
+    {
+        tree_splay(fit);
+    }
+    return fit;
+}
+
+/*
+ * tree_less: orders tree nodes by size, breaking ties by address so that
+ *            every free block has a distinct key.
+ */
+static bool tree_less(block_t *a, block_t *b)
+{
+    return get_size(a) < get_size(b) || (get_size(a) == get_size(b) && a < b);
+}
+
+/*
+ * The rotations, splay and replace below follow the splay tree in stree.c,
+ * with the nodes embedded in the free blocks themselves.
+ */
+static void tree_left_rotate(block_t *x)
+{
+    block_t *y = x->right;
+    if (y)
+    {
+        x->right = y->left;
+        if (y->left) y->left->parent = x;
+        y->parent = x->parent;
+    }
+    if (!x->parent) arena->tree_root = y;
+    else if (x == x->parent->left) x->parent->left = y;
+    else x->parent->right = y;
+    if (y) y->left = x;
+    x->parent = y;
+}
+
+static void tree_right_rotate(block_t *x)
+{
+    block_t *y = x->left;
+    if (y)
+    {
+        x->left = y->right;
+        if (y->right) y->right->parent = x;
+        y->parent = x->parent;
+    }
+    if (!x->parent) arena->tree_root = y;
+    else if (x == x->parent->left) x->parent->left = y;
+    else x->parent->right = y;
+    if (y) y->right = x;
+    x->parent = y;
+}
+
+static void tree_splay(block_t *x)
+{
+    while (x->parent)
+    {
+        if (!x->parent->parent)
+        {
+            if (x->parent->left == x) tree_right_rotate(x->parent);
+            else tree_left_rotate(x->parent);
+        }
+        else if (x->parent->left == x && x->parent->parent->left == x->parent)
+        {
+            tree_right_rotate(x->parent->parent);
+            tree_right_rotate(x->parent);
+        }
+        else if (x->parent->right == x && x->parent->parent->right == x->parent)
+        {
+            tree_left_rotate(x->parent->parent);
+            tree_left_rotate(x->parent);
+        }
+        else if (x->parent->left == x && x->parent->parent->right == x->parent)
+        {
+            tree_right_rotate(x->parent);
+            tree_left_rotate(x->parent);
+        }
+        else
+        {
+            tree_left_rotate(x->parent);
+            tree_right_rotate(x->parent);
+        }
+    }
+}
+
+static void tree_replace(block_t *u, block_t *v)
+{
+    if (!u->parent) arena->tree_root = v;
+    else if (u == u->parent->left) u->parent->left = v;
+    else u->parent->right = v;
+    if (v) v->parent = u->parent;
+}
+
+static block_t *tree_minimum(block_t *u)
+{
+    while (u->left) u = u->left;
+    return u;
+}
+
+/*
+ * tlsf_mapping: returns the first and second level class of a free block
+ *               of the given size.
+ */
+static void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+    if (size < TLSF_SMALL_SIZE)
+    {
+        *fl = 0;
+        *sl = size / dsize;
+        return;
+    }
+    int log2 = 63 - __builtin_clzl(size);
+    *fl = log2 - TLSF_FL_SHIFT + 1;
+    *sl = (size >> (log2 - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    if (*fl >= TLSF_FL_COUNT)
+    {
+        *fl = TLSF_FL_COUNT - 1;
+        *sl = TLSF_SL_COUNT - 1;
+    }
+}
+
+/*
+ * tlsf_insert: pushes a free block onto the list of its class and marks
+ *              the class as non-empty in both bitmaps.
+ */
+static void tlsf_insert(block_t *block)
+{
+    int fl, sl;
+    tlsf_mapping(get_size(block), &fl, &sl);
+
+    set_previous(block, NULL);
+    set_next(block, arena->tlsf_list[fl][sl]);
+    if (get_next(block) != NULL)
+    {
+        set_previous(get_next(block), block);
+    }
+    arena->tlsf_list[fl][sl] = block;
+    arena->tlsf_fl_bitmap |= 1UL << fl;
+    arena->tlsf_sl_bitmap[fl] |= 1UL << sl;
+}
+
+/*
+ * tlsf_remove: unlinks a free block from the list of its class, clearing
+ *              the bitmaps if the list becomes empty.
+ */
+static void tlsf_remove(block_t *block)
+{
+    int fl, sl;
+    tlsf_mapping(get_size(block), &fl, &sl);
+
+    if (get_next(block) != NULL)
+    {
+        set_previous(get_next(block), get_previous(block));
+    }
+    if (get_previous(block) != NULL)
+    {
+        set_next(get_previous(block), get_next(block));
+    }
+    else
+    {
+        arena->tlsf_list[fl][sl] = get_next(block);
+        if (arena->tlsf_list[fl][sl] == NULL)
+        {
+            arena->tlsf_sl_bitmap[fl] &= ~(1UL << sl);
+            if (arena->tlsf_sl_bitmap[fl] == 0)
+            {
+                arena->tlsf_fl_bitmap &= ~(1UL << fl);
+            }
+        }
+    }
+}
+
+/*
+ * tlsf_find_fit: returns a free block of at least asize bytes in constant
+ *                time.  asize is rounded up to the next class boundary,
+ *                so that any block in that class or a larger one fits, and
+ *                the bitmaps give the first non-empty such class.
+ */
+static block_t *tlsf_find_fit(size_t asize)
+{
+    int fl, sl;
+
+    if (asize >= TLSF_SMALL_SIZE)
+    {
+        asize += (1UL << ((63 - __builtin_clzl(asize)) - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping(asize, &fl, &sl);
+
+    // First look for a larger class on the same first level ...
+    unsigned long sl_map = arena->tlsf_sl_bitmap[fl] & (~0UL << sl);
+    if (sl_map == 0)
+    {
+        // ... then take the smallest class of the next non-empty first level
+        unsigned long fl_map = (fl + 1 < TLSF_FL_COUNT) ? arena->tlsf_fl_bitmap & (~0UL << (fl + 1)) : 0;
+        if (fl_map == 0)
+        {
+            return NULL;
+        }
+        fl = __builtin_ctzl(fl_map);
+        sl_map = arena->tlsf_sl_bitmap[fl];
+    }
+    sl = __builtin_ctzl(sl_map);
+    // The head of the class is taken without looking at any other block
+    if (MM_STATS)
+    {
+        arena->counters.fit_probes++;
+    }
+    return arena->tlsf_list[fl][sl];
+}
+
+/*
+ * arena_home: returns the calling thread's arena, handing one out round
+ *             robin the first time the thread asks.
+ */
+static arena_t *arena_home(void)
+{
+    if (home_arena == NULL)
+    {
+        unsigned int next = __atomic_fetch_add(&arena_next, 1, __ATOMIC_RELAXED);
+        home_arena = &arenas[next % ARENAS];
+    }
+    return home_arena;
+}
+
+/*
+ * arena_of: returns the arena whose region holds bp.  A mapped block, or
+ *           NULL, belongs to no arena, and the calling thread's is used.
+ */
+static arena_t *arena_of(void *bp)
+{
+    if (ARENAS == 1 || bp == NULL || is_mapped(bp))
+    {
+        return arena_home();
+    }
+    return &arenas[mem_region_of(bp)];
+}
+
+/*
+ * arena_lock: makes a the arena being worked on, taking its lock in a
+ *             thread-safe build, and frees whatever other threads have
+ *             queued for it since the lock was last taken.
+ */
+static void arena_lock(arena_t *a)
+{
+    if (THREADS)
+    {
+        pthread_mutex_lock(&a->mutex);
+    }
+    arena = a;
+    if (THREADS && __atomic_load_n(&a->remote_list, __ATOMIC_RELAXED) != NULL)
+    {
+        remote_drain();
+    }
+}
+
+static void arena_unlock(void)
+{
+    if (THREADS)
+    {
+        pthread_mutex_unlock(&arena->mutex);
+    }
+}
+
+/*
+ * remote_push: queues the payload bp for the arena that holds it, from a
+ *              thread that does not allocate from that arena.  The block
+ *              stays allocated until the queue is drained.  The queue is
+ *              a lock-free stack linked through each payload's first word,
+ *              so any number of threads can push with a single
+ *              compare-and-swap each.
+ */
+static void remote_push(arena_t *owner, void *bp)
+{
+    void *head = __atomic_load_n(&owner->remote_list, __ATOMIC_RELAXED);
+    do
+    {
+        *(void **)bp = head;
+    } while (!__atomic_compare_exchange_n(&owner->remote_list, &head, bp, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * remote_drain: takes the whole queue of the arena being worked on in one
+ *               exchange and frees every payload on it.  The caller holds
+ *               the arena's lock.  Since the queue is only ever emptied
+ *               whole, a pushed payload cannot reappear at its head while
+ *               a push is in flight.
+ */
+static void remote_drain(void)
+{
+    void *bp = __atomic_exchange_n(&arena->remote_list, NULL, __ATOMIC_ACQUIRE);
+    while (bp != NULL)
+    {
+        void *next = *(void **)bp;
+        heap_free(bp);
+        bp = next;
+    }
+}
+
+/*
+ * tcache_get: returns the calling thread's cache.  A cache filled from an
+ *             earlier heap is emptied, since mm_init has thrown its objects
+ *             away.  On first use the thread registers the cache, so that
+ *             it is flushed back to the heap when the thread exits.
+ */
+static tcache_t *tcache_get(void)
+{
+    tcache_t *cache = &tcache;
+    unsigned long generation = __atomic_load_n(&heap_generation, __ATOMIC_ACQUIRE);
+
+    if (cache->generation != generation)
+    {
+        if (cache->generation == 0)
+        {
+            pthread_once(&tcache_once, tcache_key_create);
+            pthread_setspecific(tcache_key, cache);
+        }
+        memset(cache->count, 0, sizeof(cache->count));
+        cache->generation = generation;
+    }
+    return cache;
+}
+
+/*
+ * tcache_malloc: returns an object of the slab class for size bytes from
+ *                the thread's cache.  An empty cache is first refilled to
+ *                half its capacity from the slabs, under the lock.
+ */
+static void *tcache_malloc(size_t size)
+{
+    int index = (size - 1) / dsize;
+    tcache_t *cache = tcache_get();
+
+    if (cache->count[index] == 0)
+    {
+        arena_lock(arena_home());
+        if (arena->heap_start == NULL && arena_ready())
+        {
+            cache->generation = heap_generation;
+        }
+        while (cache->count[index] < TCACHE_SIZE / 2)
+        {
+            void *bp = slab_malloc(size);
+            if (bp == NULL)
+            {
+                break;
+            }
+            cache->objects[index][cache->count[index]++] = bp;
+        }
+        arena_unlock();
+        if (cache->count[index] == 0)
+        {
+            return NULL;
+        }
+    }
+    return cache->objects[index][--cache->count[index]];
+}
+
+/*
+ * tcache_free: puts a slab object of class index into the thread's cache.
+ *              A full cache first gives half its objects back to their
+ *              slabs.  The object may come from any thread's allocation.
+ */
+static void tcache_free(int index, void *bp)
+{
+    tcache_t *cache = tcache_get();
+
+    if (cache->count[index] == TCACHE_SIZE)
+    {
+        tcache_flush(cache, index, TCACHE_SIZE / 2);
     }
-    //Case 4: Neither of the previous block and the next block are free
-    insert_at_front(block); // just add the block the beginning of the list
+    cache->objects[index][cache->count[index]++] = bp;
+}
+
+/*
+ * tcache_flush: frees cached objects of class index back to their slabs
+ *               until keep are left.  Objects of the thread's own arena are
+ *               freed under its lock, taken once; objects of other arenas
+ *               are queued for them with remote_push.
+ */
+static void tcache_flush(tcache_t *cache, int index, unsigned int keep)
+{
+    bool locked = false;
+
+    while (cache->count[index] > keep)
+    {
+        void *bp = cache->objects[index][--cache->count[index]];
+        arena_t *owner = arena_of(bp);
+        if (owner != arena_home())
+        {
+            remote_push(owner, bp);
+            continue;
+        }
+        if (!locked)
+        {
+            arena_lock(owner);
+            locked = true;
+        }
+        slab_free(find_slab(bp), bp);
+    }
+    if (locked)
+    {
+        arena_unlock();
+    }
+}
+
+/*
+ * tcache_release: the destructor of tcache_key, which gives everything in
+ *                 an exiting thread's cache back to the slabs.
+ */
+static void tcache_release(void *arg)
+{
+    tcache_t *cache = arg;
+
+    if (cache->generation == __atomic_load_n(&heap_generation, __ATOMIC_ACQUIRE))
+    {
+        for (int index = 0; index < SLAB_CLASSES; index++)
+        {
+            tcache_flush(cache, index, 0);
+        }
+    }
+}
+
+static void tcache_key_create(void)
+{
+    pthread_key_create(&tcache_key, tcache_release);
+}
+
+/*
+ * map_malloc: returns the payload of a block in a mapped region of its own.
+ *             The header sits one word into the region, so the payload
+ *             starts dsize bytes in and is aligned; the header's size is
+ *             that of the whole region.
+ */
+static void *map_malloc(size_t size)
+{
+    // Rounding a size this close to SIZE_MAX up to pages would wrap around
+    if (size > SIZE_MAX - dsize - mem_pagesize())
+    {
+        return NULL;
+    }
+    size_t length = round_up(size + dsize, mem_pagesize());
+
+    if (THREADS)
+    {
+        pthread_mutex_lock(&map_mutex);
+    }
+    char *region = mem_map(length);
+    if (THREADS)
+    {
+        pthread_mutex_unlock(&map_mutex);
+    }
+    if (region == (void *)-1)
+    {
+        return NULL;
+    }
+    block_t *block = (block_t *)(region + wsize);
+    write_header(block, length, true, false, true);
+    return header_to_payload(block);
+}
+
+/*
+ * map_free: returns the region of a mapped block to memlib.
+ */
+static void map_free(block_t *block)
+{
+    if (THREADS)
+    {
+        pthread_mutex_lock(&map_mutex);
+    }
+    mem_unmap((char *)block - wsize);
+    if (THREADS)
+    {
+        pthread_mutex_unlock(&map_mutex);
+    }
+}
+
+/*
+ * is_mapped: returns true if bp lies outside the heap's reservation, and
+ *            so is the payload of a mapped block.
+ */
+static bool is_mapped(void *bp)
+{
+    return (size_t)((char *)bp - (char *)mem_heap_lo()) >= MAX_DENSE_HEAP;
+}
+
+/*
+ * buddy_malloc: returns the payload of a block of the smallest order that
+ *               holds size bytes.  The block is taken from the smallest
+ *               non-empty order that is big enough, growing the heap if
+ *               there is none, and halved until it has the right order;
+ *               each upper half goes on the free list of its order.
+ */
+static void *buddy_malloc(size_t size)
+{
+    int order = buddy_order(size);
+    if (order > BUDDY_MAX_ORDER)
+    {
+        return NULL;
+    }
+    if ((arena->buddy_bitmap & (~0UL << order)) == 0 && !buddy_grow(order))
+    {
+        return NULL;
+    }
+
+    block_t *block = arena->buddy_list[__builtin_ctzl(arena->buddy_bitmap & (~0UL << order))];
+    buddy_remove(block);
+    while (get_size(block) > (1UL << order))
+    {
+        size_t half = get_size(block) / 2;
+        block_t *block_upper = (block_t *)((char *)block + half);
+        write_header(block_upper, half, false, false, false);
+        buddy_insert(block_upper);
+        write_header(block, half, false, false, false);
+        if (MM_STATS)
+        {
+            arena->counters.splits++;
+        }
+    }
+    write_header(block, get_size(block), false, false, true);
+    return header_to_payload(block);
+}
+
+/*
+ * buddy_free: frees a block and merges it with its buddy for as long as
+ *             the buddy is a free block of the same order.
+ */
+static void buddy_free(block_t *block)
+{
+    write_header(block, get_size(block), false, false, false);
+    while (get_size(block) < (1UL << BUDDY_MAX_ORDER))
+    {
+        block_t *buddy = buddy_of(block);
+        if ((void *)buddy > mem_region_hi(arena->region) || get_alloc(buddy) || get_size(buddy) != get_size(block))
+        {
+            break;
+        }
+        buddy_remove(buddy);
+        if (MM_STATS)
+        {
+            arena->counters.coalesces++;
+        }
+        if (buddy < block)
+        {
+            block = buddy;
+        }
+        write_header(block, 2 * get_size(buddy), false, false, false);
+    }
+    buddy_insert(block);
+}
+
+/*
+ * buddy_realloc: a block that is already big enough gives back the upper
+ *                halves it no longer needs; otherwise the payload moves to
+ *                a new block.
+ */
+static void *buddy_realloc(void *ptr, size_t size)
+{
+    block_t *block = buddy_header(ptr);
+    int order = buddy_order(size);
+
+    if (ptr == header_to_payload(block) && order <= BUDDY_MAX_ORDER && (1UL << order) <= get_size(block))
+    {
+        while (get_size(block) > (1UL << order))
+        {
+            size_t half = get_size(block) / 2;
+            block_t *block_upper = (block_t *)((char *)block + half);
+            write_header(block, half, false, false, true);
+            write_header(block_upper, half, false, false, true);
+            buddy_free(block_upper); // its buddy is our block, so it cannot merge
+        }
+        return ptr;
+    }
+
+    void *newptr = heap_malloc(size);
+    if (newptr == NULL)
+    {
+        return NULL;
+    }
+    size_t copysize = malloc_usable_size(ptr);
+    memcpy(newptr, ptr, (size < copysize) ? size : copysize);
+    heap_free(ptr);
+    return newptr;
+}
+
+/*
+ * buddy_memalign: returns a payload of size bytes aligned to alignment
+ *                 bytes, a power of two above dsize.  It is the first
+ *                 aligned spot in a block with room for size bytes past
+ *                 any such spot.  Unless that is the block's own payload,
+ *                 the word before it is an inner header, with prev_mini
+ *                 set, whose size is how far back the block's header is.
+ */
+static void *buddy_memalign(size_t alignment, size_t size)
+{
+    char *bp = buddy_malloc(size + alignment - wsize);
+    if (bp == NULL)
+    {
+        return NULL;
+    }
+    char *aligned = (char *)round_up((uintptr_t)bp, alignment);
+    if (aligned != bp)
+    {
+        block_t *inner = payload_to_header(aligned);
+        write_header(inner, (char *)inner - (char *)payload_to_header(bp), false, true, true);
+    }
+    return aligned;
+}
 
+/*
+ * buddy_header: returns the header of the buddy block that the payload bp
+ *               lies in, going back from an inner header to it.  No other
+ *               buddy header has prev_mini set.
+ */
+static block_t *buddy_header(void *bp)
+{
+    block_t *block = payload_to_header(bp);
+    if (get_prev_mini(block))
+    {
+        block = (block_t *)((char *)block - get_size(block));
+    }
     return block;
 }
 
-// helper function to remove block pointers when coalescing
-static void remove_block(block_t *block){
-    if(block -> previous != NULL && block -> next != NULL){
-        // how can I get the next pointer of the previous block? Then set it to the next block
-        block -> previous -> next = block -> next;
-        block -> next -> previous = block -> previous;
+/*
+ * buddy_grow: extends the heap until it holds a free block of at least the
+ *             given order.  A block can only start at a multiple of its
+ *             size, so the space up to the next such multiple is first
+ *             filled with the largest blocks that fit there, which are
+ *             freed (and merged) like any other.
+ */
+static bool buddy_grow(int order)
+{
+    size_t top = (char *)mem_region_hi(arena->region) + 1 - (char *)arena->heap_start;
+
+    while ((arena->buddy_bitmap & (~0UL << order)) == 0)
+    {
+        size_t size = (top == 0) ? (1UL << order) : (top & -top);
+        if (size > (1UL << order))
+        {
+            size = 1UL << order;
+        }
+        block_t *block = (block_t *)mem_region_sbrk(arena->region, size);
+        if ((void *)block == (void *)-1)
+        {
+            return false;
+        }
+        write_header(block, size, false, false, true);
+        buddy_free(block);
+        top += size;
     }
-    // Case 2: the block is at the tail of the list. There is no block after that to link to
-    else if(block -> previous != NULL && block -> next == NULL)   
+    return true;
+}
+
+/*
+ * buddy_order: returns the smallest order whose blocks hold a header and
+ *              size bytes of payload, or BUDDY_MAX_ORDER + 1 if no order
+ *              does.
+ */
+static int buddy_order(size_t size)
+{
+    // size + wsize would wrap around for sizes near SIZE_MAX
+    if (size > (1UL << BUDDY_MAX_ORDER))
     {
-        block -> previous -> next = NULL;
-        // no block -> next
+        return BUDDY_MAX_ORDER + 1;
     }
-    // Case 3: The block is at the beginning of the list
-    else if (block -> previous == NULL && block -> next != NULL){
-        block -> next -> previous = NULL;
-        // update the list_start to point at the next block
-        list_start = block -> next;
+    int order = 64 - __builtin_clzl(size + wsize - 1);
+    return (order < BUDDY_MIN_ORDER) ? BUDDY_MIN_ORDER : order;
+}
+
+/*
+ * buddy_of: returns the buddy of a block, the other half of the block of
+ *           twice its size that it was split from.  It may lie past the
+ *           top of the heap, or be split further.
+ */
+static block_t *buddy_of(block_t *block)
+{
+    size_t offset = (char *)block - (char *)arena->heap_start;
+    return (block_t *)((char *)arena->heap_start + (offset ^ get_size(block)));
+}
+
+/*
+ * buddy_insert: pushes a free block onto the list of its order and marks
+ *               the order as non-empty.
+ */
+static void buddy_insert(block_t *block)
+{
+    int order = __builtin_ctzl(get_size(block));
+
+    set_previous(block, NULL);
+    set_next(block, arena->buddy_list[order]);
+    if (get_next(block) != NULL)
+    {
+        set_previous(get_next(block), block);
     }
-    // Case 4: The block is the only thing in the list
-    else if (block -> previous == NULL && block -> next == NULL){
-        list_start = NULL;
+    arena->buddy_list[order] = block;
+    arena->buddy_bitmap |= 1UL << order;
+}
+
+/*
+ * buddy_remove: unlinks a free block from the list of its order, clearing
+ *               the bitmap if the list becomes empty.
+ */
+static void buddy_remove(block_t *block)
+{
+    int order = __builtin_ctzl(get_size(block));
+
+    if (get_next(block) != NULL)
+    {
+        set_previous(get_next(block), get_previous(block));
+    }
+    if (get_previous(block) != NULL)
+    {
+        set_next(get_previous(block), get_next(block));
+    }
+    else
+    {
+        arena->buddy_list[order] = get_next(block);
+        if (arena->buddy_list[order] == NULL)
+        {
+            arena->buddy_bitmap &= ~(1UL << order);
+        }
+    }
+}
+
+/*
+ * slab_malloc: returns an object of the smallest class that holds size
+ *              bytes, taken from a partial slab of that class or from a
+ *              new slab.  Finding the object is a find-first-set in the
+ *              slab's free map.
+ */
+static void *slab_malloc(size_t size)
+{
+    int index = (size - 1) / dsize;
+    slab_t *slab = arena->slab_partial[index];
+
+    if (slab == NULL)
+    {
+        slab = slab_new(index);
+        if (slab == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    int word = 0;
+    while (slab->free_map[word] == 0)
+    {
+        word++;
     }
+    int bit = __builtin_ctzl(slab->free_map[word]);
+    slab->free_map[word] &= ~(1UL << bit);
 
+    slab->used++;
+    if (slab->used == slab->capacity)
+    {
+        slab_unlink(index, slab); // full slabs are not on any list
+    }
+    return slab_objects(slab) + (size_t)(word * 64 + bit) * slab->object_size;
 }
 
-// helper function to insert a block at the front of the doubly linked list
-static void insert_at_front(block_t *block){
-    /* If the free list has nothing, set it the first one*/
-    if(list_start == NULL){
-        block -> next = NULL;
-        block -> previous = NULL;
-        list_start = block;
-        return;
+/*
+ * slab_free: returns an object to its slab.  A slab that empties goes back
+ *            to the heap as an ordinary free block.
+ */
+static void slab_free(slab_t *slab, void *bp)
+{
+    int index = slab->object_size / dsize - 1;
+    size_t object = ((char *)bp - slab_objects(slab)) / slab->object_size;
+
+    slab->free_map[object / 64] |= 1UL << (object % 64);
+    if (slab->used == slab->capacity)
+    {
+        slab_push(index, slab);
+    }
+    slab->used--;
+
+    if (slab->used == 0)
+    {
+        slab_unlink(index, slab);
+        slab_release(slab);
+    }
+}
+
+/*
+ * slab_new: carves a new, empty slab for size class index out of a heap
+ *           block whose payload starts on a page boundary, and puts it on
+ *           the partial list.  The block is exactly a page long, so a run
+ *           of slabs sits back to back with no space between pages.
+ */
+static slab_t *slab_new(int index)
+{
+    block_t *block = alloc_aligned(slab_page_size, slab_page_size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    slab_t *slab = (slab_t *)header_to_payload(block);
+    slab->object_size = (index + 1) * dsize;
+    slab->used = 0;
+    slab->capacity = ((char *)slab + get_payload_size(block) - slab_objects(slab)) / slab->object_size;
+    memset(slab->free_map, 0, sizeof(slab->free_map));
+    for (unsigned int i = 0; i < slab->capacity; i++)
+    {
+        slab->free_map[i / 64] |= 1UL << (i % 64);
+    }
+
+    size_t page = slab_page_number(slab);
+    __atomic_fetch_or(&slab_map[page / 64], 1UL << (page % 64), __ATOMIC_RELAXED);
+    slab_push(index, slab);
+    return slab;
+}
+
+/*
+ * slab_release: hands the page of an empty slab back to the heap.
+ */
+static void slab_release(slab_t *slab)
+{
+    size_t page = slab_page_number(slab);
+    __atomic_fetch_and(&slab_map[page / 64], ~(1UL << (page % 64)), __ATOMIC_RELAXED);
+    heap_free(slab);
+}
+
+/*
+ * find_slab: returns the slab that bp points into, or NULL if bp is the
+ *            payload of an ordinary block.  A slab's payload covers its
+ *            page up to the header of the next block, so no other payload
+ *            can share the page.
+ */
+static slab_t *find_slab(void *bp)
+{
+    size_t page = slab_page_number(bp);
+    if (!(__atomic_load_n(&slab_map[page / 64], __ATOMIC_RELAXED) & (1UL << (page % 64))))
+    {
+        return NULL;
+    }
+    return (slab_t *)((char *)mem_heap_lo() + page * slab_page_size);
+}
+
+/*
+ * slab_page_number: returns the number of the heap page holding bp.
+ */
+static size_t slab_page_number(void *bp)
+{
+    return ((char *)bp - (char *)mem_heap_lo()) / slab_page_size;
+}
+
+/*
+ * slab_objects: returns the address of the first object in a slab, just
+ *               after the slab_t header.
+ */
+static char *slab_objects(slab_t *slab)
+{
+    return (char *)slab + round_up(sizeof(slab_t), dsize);
+}
+
+// helper function to push a slab onto the partial list of its class
+static void slab_push(int index, slab_t *slab)
+{
+    slab->previous = NULL;
+    slab->next = arena->slab_partial[index];
+    if (slab->next != NULL)
+    {
+        slab->next->previous = slab;
+    }
+    arena->slab_partial[index] = slab;
+}
+
+// helper function to take a slab off the partial list of its class
+static void slab_unlink(int index, slab_t *slab)
+{
+    if (slab->previous != NULL)
+    {
+        slab->previous->next = slab->next;
+    }
+    else
+    {
+        arena->slab_partial[index] = slab->next;
+    }
+    if (slab->next != NULL)
+    {
+        slab->next->previous = slab->previous;
     }
-    block -> next = list_start; //set the next pointer to point to list_start so that the block can be the head of the list
-    list_start -> previous = block; //set the previous pointer of the list_start to block to properly linked
-    block -> previous = NULL; //set the previous pointer of block to NULL
-    list_start = block; //set the block to be the start of the list
 }
 
 /*
@@ -446,48 +2853,308 @@ static void place(block_t *block, size_t asize)
 {
     size_t csize = get_size(block);
 
-    if ((csize - asize) >= min_block_size) // This is checking if the size of a block is very big so that we can split it and don't have to use the entire block to store data
+    if ((csize - asize) >= smallest_block_size) // This is checking if the size of a block is very big so that we can split it and don't have to use the entire block to store data
     {
         block_t *block_next;
-        remove_block(block); //remove this block from the free list because it is now is occupied
-        write_header(block, asize, true);
-        write_footer(block, asize, true);
+        block_t *hint = remove_block(block); //remove this block from the free list because it is now is occupied
+        if (MM_STATS)
+        {
+            arena->counters.splits++;
+        }
+        write_header(block, asize, get_prev_alloc(block), get_prev_mini(block), true);
 
         block_next = find_next(block);
-        write_header(block_next, csize-asize, false);
+        write_header(block_next, csize-asize, true, asize == mini_block_size, false);
         write_footer(block_next, csize-asize, false);
-        insert_at_front(block_next); // coalesce the block_next which is spliced from the original big block
+        insert_free(block_next, hint); // file the block_next which is spliced from the original big block
+        write_next_prev_bits(block_next); // the remainder may be a mini block
     }
     // if the block just fits the requested block's size
     else
     { 
         remove_block(block); //removing this block from the free list
-        write_header(block, csize, true);
-        write_footer(block, csize, true);
+        write_header(block, csize, get_prev_alloc(block), get_prev_mini(block), true);
+        write_next_prev_bits(block); // the next block now follows an allocated block
+    }
+}
+
+/*
+ * split_allocated: shrinks an allocated block to asize bytes.  If the tail
+ *                  left over is big enough to be a block of its own, it is
+ *                  freed and coalesced with the block after it.
+ */
+static void split_allocated(block_t *block, size_t asize)
+{
+    size_t csize = get_size(block);
+
+    if ((csize - asize) < smallest_block_size)
+    {
+        return;
+    }
+    if (MM_STATS)
+    {
+        arena->counters.splits++;
+    }
+    write_header(block, asize, get_prev_alloc(block), get_prev_mini(block), true);
+
+    block_t *block_next = find_next(block);
+    write_header(block_next, csize-asize, true, asize == mini_block_size, false);
+    write_footer(block_next, csize-asize, false);
+    coalesce(block_next);
+}
+
+/*
+ * grow_in_place: tries to grow an allocated block to asize bytes without
+ *                moving it, by absorbing the free block after it.  If the
+ *                block (or the free block after it) is the last one in the
+ *                heap, the heap is extended to make up the shortfall.
+ *                Returns false, leaving the block untouched, if the block
+ *                cannot grow.
+ */
+static bool grow_in_place(block_t *block, size_t asize)
+{
+    size_t csize = get_size(block);
+    block_t *block_next = find_next(block);
+    size_t available = csize;
+
+    if (!get_alloc(block_next))
+    {
+        available += get_size(block_next);
+    }
+
+    if (available < asize)
+    {
+        // Only the top of the heap can grow: the next block must be
+        // the epilogue, or a free block just before it
+        block_t *block_last = get_alloc(block_next) ? block_next : find_next(block_next);
+        if (get_size(block_last) != 0)
+        {
+            return false;
+        }
+        if (extend_heap(grow_step(asize - available)) == NULL)
+        {
+            return false;
+        }
+        // extend_heap coalesced the new space with any free block after ours
+        block_next = find_next(block);
+        available = csize + get_size(block_next);
+    }
+
+    // Absorb the free block after ours, then give back what isn't needed
+    remove_block(block_next);
+    write_header(block, available, get_prev_alloc(block), get_prev_mini(block), true);
+    write_next_prev_bits(block);
+    split_allocated(block, asize);
+    return true;
+}
+
+/*
+ * alloc_aligned: returns an allocated block of asize bytes whose payload is
+ *                aligned to align bytes (a multiple of dsize).  The block is
+ *                carved out of a free block big enough for any alignment,
+ *                or else out of the top of the heap, which is extended by
+ *                just what that block needs.  The leading slack is freed
+ *                again, and so is the tail.
+ */
+static block_t *alloc_aligned(size_t asize, size_t align)
+{
+    block_t *block = find_fit(asize + align + smallest_block_size);
+    if (block == NULL && quick_flush())
+    {
+        block = find_fit(asize + align + smallest_block_size);
+    }
+
+    if (block == NULL)
+    {
+        // The new space starts at the epilogue, or at the free block before it
+        block_t *block_top = payload_to_header((char *)mem_region_hi(arena->region) + 1);
+        size_t available = 0;
+        if (!get_prev_alloc(block_top))
+        {
+            block_top = find_prev(block_top);
+            available = get_size(block_top);
+        }
+        size_t needed = aligned_lead(block_top, align) + asize;
+        if (needed > available)
+        {
+            block_top = extend_heap(needed - available);
+            if (block_top == NULL)
+            {
+                return NULL;
+            }
+        }
+        block = block_top;
+    }
+    size_t lead = aligned_lead(block, align);
+    place(block, get_size(block));
+
+    if (lead != 0)
+    {
+        size_t csize = get_size(block);
+        block_t *block_aligned = (block_t *)((char *)block + lead);
+        write_header(block_aligned, csize - lead, false, lead == mini_block_size, true);
+        write_next_prev_bits(block_aligned); // it may be a mini block now
+        write_header(block, lead, get_prev_alloc(block), get_prev_mini(block), false);
+        write_footer(block, lead, false);
+        coalesce(block);
+        block = block_aligned;
+    }
+    split_allocated(block, asize);
+    return block;
+}
+
+/*
+ * aligned_lead: returns how far into a block an aligned block has to start
+ *               for its payload to be aligned to align bytes.  The slack in
+ *               front must be able to stand as a free block of its own.
+ */
+static size_t aligned_lead(block_t *block, size_t align)
+{
+    size_t lead = (align - (uintptr_t)header_to_payload(block) % align) % align;
+    if (lead != 0 && lead < smallest_block_size)
+    {
+        lead += align;
+    }
+    return lead;
+}
+
+/*
+ * adjust_size: returns the size of the block needed for a payload of
+ *              size bytes.  Allocated blocks have no footer, so requests
+ *              of up to a word fit in a mini block.
+ */
+static size_t adjust_size(size_t size)
+{
+    return max(round_up(size + wsize, dsize), smallest_block_size);
+}
+
+/*
+ * find_fit: returns a free block of at least asize bytes, or NULL.  With
+ *           MM_STATS set, counts the call and the free blocks it probed.
+ */
+static block_t *find_fit(size_t asize)
+{
+    if (!MM_STATS)
+    {
+        return search_fit(asize);
+    }
+
+    size_t probes = arena->counters.fit_probes;
+    block_t *block = search_fit(asize);
+    probes = arena->counters.fit_probes - probes;
+    arena->counters.fit_calls++;
+    if (probes > arena->counters.fit_probes_max)
+    {
+        arena->counters.fit_probes_max = probes;
     }
+    return block;
 }
 
 /*
  * <what does find_fit do?>
+ * search_fit does the search for find_fit.
  * 
- * Modified findfit function to iterate through the doubly linked list and find the a fit for the block
- * of a given size.
+ * Searches the mini list and the segregated lists for a free block of at least asize bytes.
+ * The search starts in the list for asize's size class, where blocks may
+ * still be too small, and moves on to larger classes until a fit is found.
+ * Blocks of tree_min_size and up are found by a best fit search of the tree.
+ */
+
+static block_t *search_fit(size_t asize){
+    if(TLSF){
+        return tlsf_find_fit(asize);
+    }
+
+    // Any free mini block is an exact fit for a mini request
+    if(!COMPACT_LINKS && asize == mini_block_size && arena->mini_list != NULL){
+        if(MM_STATS){
+            arena->counters.fit_probes++;
+        }
+        return arena->mini_list;
+    }
+    for(int index = find_list_index(asize); index < SEG_LISTS; index++){
+        if(fit_policy != MM_FIT_FIRST){
+            block_t *block = (fit_policy == MM_FIT_NEXT) ? next_fit(index, asize) : good_fit(index, asize);
+            if(block != NULL){
+                return block;
+            }
+            continue;
+        }
+        // In order to traverse from the beginning of the list, block is at the beginning of the list
+        block_t * block = arena->seg_list[index];
+        // traverse the entire free list
+        while(block != NULL){
+            if(MM_STATS){
+                arena->counters.fit_probes++;
+            }
+            if(asize <= get_size(block)){    //if the free block's size fits the requested block's size
+                return block;
+            }
+            block = get_next(block); //traverse through the doubly linked list
+        }
+    }
+    return tree_find_fit(asize);        //large blocks: best fit from the tree, or NULL if no fit
+}
+
+/*
+ * next_fit: searches segregated list index for a block of at least asize
+ *           bytes, starting at the list's rover and wrapping around to the
+ *           head.  The rover is left just after the block found, so blocks
+ *           that were too small this time are not looked at again first.
+ *           remove_block moves the rover on when it unlinks the block under
+ *           it, which covers blocks taken by place and merged by coalesce.
  */
+static block_t *next_fit(int index, size_t asize)
+{
+    block_t *start = (arena->seg_rover[index] != NULL) ? arena->seg_rover[index] : arena->seg_list[index];
 
-static block_t *find_fit(size_t asize){
-    // In order to traverse from the beginning of the list, block is at the beginning of the list
-    block_t * block = list_start;
-    // traverse the entire free list
-    while(block != NULL){
-        if((asize <= get_size(block)) && (!(get_alloc(block)))){    //if the free block's size fits the requested block's size
+    for(block_t *block = start; block != NULL; block = get_next(block)){
+        if(MM_STATS){
+            arena->counters.fit_probes++;
+        }
+        if(asize <= get_size(block)){
+            arena->seg_rover[index] = get_next(block);
+            return block;
+        }
+    }
+    for(block_t *block = arena->seg_list[index]; block != start; block = get_next(block)){
+        if(MM_STATS){
+            arena->counters.fit_probes++;
+        }
+        if(asize <= get_size(block)){
+            arena->seg_rover[index] = get_next(block);
             return block;
         }
-        else{
-        block = block -> next; //traverse through the doubly linked list
+    }
+    return NULL;
+}
+
+/*
+ * good_fit: searches segregated list index for the smallest block of at
+ *           least asize bytes among the first fit_scan_limit that fit,
+ *           stopping early at an exact fit.  Every block on a later list is
+ *           bigger than any on this one, so the search never goes on to
+ *           the next list once something fits.
+ */
+static block_t *good_fit(int index, size_t asize)
+{
+    block_t *best = NULL;
+    size_t candidates = 0;
+
+    for(block_t *block = arena->seg_list[index]; block != NULL; block = get_next(block)){
+        if(MM_STATS){
+            arena->counters.fit_probes++;
+        }
+        if(asize <= get_size(block)){
+            if(best == NULL || get_size(block) < get_size(best)){
+                best = block;
+            }
+            if(get_size(block) == asize || ++candidates == fit_scan_limit){
+                break;
+            }
         }
-        
     }
-    return NULL;                        //if no fit then return NULL
+    return best;
 }
 
 /* 
@@ -496,37 +3163,68 @@ static block_t *find_fit(size_t asize){
  * First, I need to check the heap: Prologue block -> iterate through the heap and check each block
  * -> Probably I need to create a helper function for this check -> Epilogue block
  * Then, I need to check for the validation of the free list by checking their previous/next pointers
+ * With several arenas, only the one the calling thread last worked on is checked.
  */
 bool mm_checkheap(int line)  
 { 
-   // (void)line; // delete this line; it's a placeholder so that the compiler
-                // will not warn you about an unused variable.
- //   printf("Going to the check_heap");
     block_t *block;
-    block = heap_start;
-    // Check prologue by checking the size of the header and the allocation bit
-    // pointer already points to the header and I can find the next header by find_next()
-    if((get_size(block) != 0) || (get_alloc(block) != 1))
+    size_t free_blocks = 0; // number of free blocks met while walking the heap
+    bool previous_free = false;
+    bool previous_mini = false;
+
+    // an arena nobody has used since mm_init has no heap yet
+    if(arena -> heap_start == NULL){
+        return true;
+    }
+
+    if(BUDDY){
+        return checkbuddy(line);
+    }
+
+    // Check prologue footer, the word just before the first block
+    word_t *prologue = find_prev_footer(arena->heap_start);
+    if((extract_size(*prologue) != 0) || !extract_alloc(*prologue))
     {
-        printf("Address: %p -- Prologue Error -- \n" , block);
+        printf("Line %d: Address: %p -- Prologue Error -- \n", line, prologue);
         assert(0);
     }
 
-    // moving to the next block
-  //  block = find_next(block);
-
     // iterate through each block of a heap
-    while(get_size(block) != 0)
+    for(block = arena->heap_start; get_size(block) != 0; block = find_next(block))
     {
         // using helper function here
         checkblock(block);
-        block = find_next(block);
+        // the header must agree with the block before it
+        if(get_prev_alloc(block) == previous_free || get_prev_mini(block) != previous_mini)
+        {
+            printf("Line %d: Address: %p -- Previous Allocation Bit Is Wrong -- \n", line, block);
+            assert(0);
+        }
+        if(!get_alloc(block))
+        {
+            // two free blocks in a row means a missed coalesce
+            if(previous_free)
+            {
+                printf("Line %d: Address: %p -- Consecutive Free Blocks -- \n", line, block);
+                assert(0);
+            }
+            free_blocks++;
+        }
+        previous_free = !get_alloc(block);
+        previous_mini = get_size(block) == mini_block_size;
+    }
+
+    // Check epilogue header
+    if(!get_alloc(block) || get_prev_alloc(block) == previous_free || get_prev_mini(block) != previous_mini
+       || (void *)((char *)block + wsize - 1) != mem_region_hi(arena->region))
+    {
+        printf("Line %d: Address: %p -- Epilogue Error -- \n", line, block);
+        assert(0);
     }
-  //  while(block != NULL){
-  //      printf("Block: %p \n", block);
-  //      block = block -> next;
-  //  } 
 
+    checklists(free_blocks);
+    checkslabs();
+    checkquick();
     return true;
 }
 
@@ -537,36 +3235,244 @@ bool mm_checkheap(int line)
  *                check for address alignment
  *                check if the header and the footer match
  */
-// I will need to fix checkblock function later
-
 static void checkblock(block_t *block)
 {
     //check each block's address alignment (multiple of n)
-    //NEED TO FIX THE EACH CHECK BECAUSE BLOCK IS AN OBJECT
     if(!alignment(block)){
        printf("Address: %p -- Block Alignment Error -- \n", block);
        assert(0);
     }
     //check whether each block is out of bounds
-  //  if(!in_heap(block)){
-  //      printf("Address: %p -- Access Memory Out of Heap -- \n", block);
-  //      assert(0);
-  //  }
+    if(!in_heap(block)){
+        printf("Address: %p -- Access Memory Out of Heap -- \n", block);
+        assert(0);
+    }
     //check the min size
-    if(get_alloc(block)){
-        if(get_size(block) < (2*dsize)){
-            printf("Address: %p -- The block size is not valid (smaller than Minimum size) -- \n", block);
-            assert(0);
-        } 
+    if(get_size(block) < smallest_block_size){
+        printf("Address: %p -- The block size is not valid (smaller than Minimum size) -- \n", block);
+        assert(0);
     }
     //check header/footer alignment
-    if(get_size(block) % wsize){
-        printf("Address: %p -- Header is not 8 bytes -- \n", block);
+    if(get_size(block) % dsize){
+        printf("Address: %p -- Block size is not a multiple of 16 -- \n", block);
+        assert(0);
+    }
+    //check if header matches footer, which only free regular blocks have
+    word_t *footerp = (word_t *)((block->payload) + get_size(block) - dsize);
+    if(!get_alloc(block) && get_size(block) != mini_block_size && (extract_size(*footerp) != get_size(block) || extract_alloc(*footerp))){
+        printf("Address: %p -- Header does not match footer -- \n", block);
+        assert(0);
+    }
+}
+
+/*
+ * checklists - check the mini list, the segregated free lists and the tree,
+ *              or the TLSF classes and bitmaps
+ * In particular: check that every block on a list is free and in the heap
+ *                check that it is filed under the right size class
+ *                check that the previous/next pointers agree
+ *                check that the lists hold exactly the free blocks of the heap
+ */
+static void checklists(size_t free_blocks)
+{
+    size_t listed = 0;
+
+    for(block_t *block = arena->mini_list; block != NULL; block = block -> mini_next){
+        if(!in_heap(block) || get_alloc(block) || get_size(block) != mini_block_size){
+            printf("Address: %p -- Mini List Holds A Block That Is Not A Free Mini Block -- \n", block);
+            assert(0);
+        }
+        listed++;
+    }
+
+    for(int index = 0; index < SEG_LISTS; index++){
+        block_t *previous = NULL;
+        bool rover_listed = (arena->seg_rover[index] == NULL);
+        for(block_t *block = arena->seg_list[index]; block != NULL; block = get_next(block)){
+            rover_listed |= (block == arena->seg_rover[index]);
+            if(!in_heap(block) || get_alloc(block)){
+                printf("Address: %p -- Listed Block Is Not A Free Heap Block -- \n", block);
+                assert(0);
+            }
+            if(find_list_index(get_size(block)) != index){
+                printf("Address: %p -- Block In Wrong Size Class (%d) -- \n", block, index);
+                assert(0);
+            }
+            if(get_previous(block) != previous){
+                printf("Address: %p -- Previous Pointer Mismatch -- \n", block);
+                assert(0);
+            }
+            if(insert_policy == MM_INSERT_ADDRESS && previous != NULL && previous > block){
+                printf("Address: %p -- List %d Out Of Address Order -- \n", block, index);
+                assert(0);
+            }
+            previous = block;
+            listed++;
+        }
+        if(!rover_listed){
+            printf("Address: %p -- Next-Fit Rover Is Not On List %d -- \n", arena->seg_rover[index], index);
+            assert(0);
+        }
+    }
+    listed += checktree(arena->tree_root, NULL);
+
+    for(int fl = 0; fl < TLSF_FL_COUNT; fl++){
+        for(int sl = 0; sl < TLSF_SL_COUNT; sl++){
+            bool marked = (arena->tlsf_fl_bitmap & (1UL << fl)) && (arena->tlsf_sl_bitmap[fl] & (1UL << sl));
+            if(marked != (arena->tlsf_list[fl][sl] != NULL)){
+                printf("-- TLSF Bitmaps Disagree With Class (%d, %d) -- \n", fl, sl);
+                assert(0);
+            }
+            block_t *previous = NULL;
+            for(block_t *block = arena->tlsf_list[fl][sl]; block != NULL; block = get_next(block)){
+                int block_fl, block_sl;
+                tlsf_mapping(get_size(block), &block_fl, &block_sl);
+                if(!in_heap(block) || get_alloc(block) || block_fl != fl || block_sl != sl
+                   || get_previous(block) != previous){
+                    printf("Address: %p -- Block Misfiled In TLSF Class (%d, %d) -- \n", block, fl, sl);
+                    assert(0);
+                }
+                previous = block;
+                listed++;
+            }
+        }
+    }
+
+    if(listed != free_blocks){
+        printf("-- Free List Holds %zu Blocks, Heap Holds %zu -- \n", listed, free_blocks);
+        assert(0);
+    }
+}
+
+/*
+ * checktree - check the subtree rooted at node and return its number of nodes
+ * In particular: check that every node is a large free block in the heap
+ *                check that the parent pointers agree
+ *                check that the nodes are ordered by (size, address)
+ */
+static size_t checktree(block_t *node, block_t *parent)
+{
+    if(node == NULL){
+        return 0;
+    }
+    if(!in_heap(node) || get_alloc(node) || get_size(node) < tree_min_size){
+        printf("Address: %p -- Tree Holds A Block That Is Not A Large Free Block -- \n", node);
         assert(0);
     }
-    //check if header matches footer
-    //WILL WRITE IT LATER
+    if(node -> parent != parent){
+        printf("Address: %p -- Parent Pointer Mismatch -- \n", node);
+        assert(0);
+    }
+    if((node -> left != NULL && !tree_less(node -> left, node)) ||
+       (node -> right != NULL && !tree_less(node, node -> right))){
+        printf("Address: %p -- Tree Out Of Order -- \n", node);
+        assert(0);
+    }
+    return 1 + checktree(node -> left, node) + checktree(node -> right, node);
+}
+
+/*
+ * checkslabs - check the partial slab lists
+ * In particular: check that every partial slab is marked in the slab map
+ *                check that it has the class of its list
+ *                check that its free map agrees with its use count
+ */
+static void checkslabs(void)
+{
+    for(int index = 0; index < SLAB_CLASSES; index++){
+        slab_t *previous = NULL;
+        for(slab_t *slab = arena->slab_partial[index]; slab != NULL; slab = slab -> next){
+            unsigned int free_objects = 0;
+            for(int word = 0; word < 4; word++){
+                free_objects += __builtin_popcountl(slab -> free_map[word]);
+            }
+            if(find_slab(slab) != slab || slab -> object_size != (index + 1) * dsize){
+                printf("Address: %p -- Partial List Holds A Page That Is Not A Slab Of Its Class -- \n", slab);
+                assert(0);
+            }
+            if(slab -> used >= slab -> capacity || slab -> used + free_objects != slab -> capacity
+               || slab -> previous != previous){
+                printf("Address: %p -- Slab Free Map Or Links Are Inconsistent -- \n", slab);
+                assert(0);
+            }
+            previous = slab;
+        }
+    }
+}
+
+/*
+ * checkbuddy - check the heap and free lists of the buddy engine
+ * In particular: check that every block is a power of two long and starts
+ *                at a multiple of its size
+ *                check that no free block has a free buddy of its own order
+ *                check that the lists hold exactly the free blocks of the heap
+ *                check that the bitmap agrees with the lists
+ */
+static bool checkbuddy(int line)
+{
+    size_t free_blocks = 0;
+    size_t listed = 0;
+
+    for(block_t *block = arena->heap_start; (void *)block <= mem_region_hi(arena->region); block = find_next(block)){
+        size_t size = get_size(block);
+        size_t offset = (char *)block - (char *)arena->heap_start;
+        if(size < (1UL << BUDDY_MIN_ORDER) || (size & (size - 1)) || offset % size){
+            printf("Line %d: Address: %p -- Buddy Block Misaligned Or Not A Power Of Two -- \n", line, block);
+            assert(0);
+        }
+        if(!get_alloc(block)){
+            block_t *buddy = buddy_of(block);
+            if((void *)buddy <= mem_region_hi(arena->region) && !get_alloc(buddy) && get_size(buddy) == size){
+                printf("Line %d: Address: %p -- Free Buddies Not Merged -- \n", line, block);
+                assert(0);
+            }
+            free_blocks++;
+        }
+    }
+
+    for(int order = 0; order <= BUDDY_MAX_ORDER; order++){
+        if(((arena->buddy_bitmap >> order) & 1) != (arena->buddy_list[order] != NULL)){
+            printf("Line %d: -- Buddy Bitmap Disagrees With Order %d -- \n", line, order);
+            assert(0);
+        }
+        block_t *previous = NULL;
+        for(block_t *block = arena->buddy_list[order]; block != NULL; block = get_next(block)){
+            if(!in_heap(block) || get_alloc(block) || get_size(block) != (1UL << order)
+               || get_previous(block) != previous){
+                printf("Line %d: Address: %p -- Block Misfiled In Buddy Order %d -- \n", line, block, order);
+                assert(0);
+            }
+            previous = block;
+            listed++;
+        }
+    }
+
+    if(listed != free_blocks){
+        printf("Line %d: -- Buddy Lists Hold %zu Blocks, Heap Holds %zu -- \n", line, listed, free_blocks);
+        assert(0);
+    }
+    return true;
+}
 
+/*
+ * checkquick - check the quick lists and return the number of blocks on them
+ * In particular: check that every block is an allocated heap block
+ *                check that it is on the list for its exact size
+ */
+static size_t checkquick(void)
+{
+    size_t listed = 0;
+
+    for(int index = 0; index < QUICK_LISTS; index++){
+        for(block_t *block = arena->quick_list[index]; block != NULL; block = block -> quick_next){
+            if(!in_heap(block) || !get_alloc(block) || get_size(block) != (size_t)(index + 1) * dsize){
+                printf("Address: %p -- Quick List %d Holds A Block Of The Wrong Size -- \n", block, index);
+                assert(0);
+            }
+            listed++;
+        }
+    }
+    return listed;
 }
 
 // helper function to return whether the pointer is aligned
@@ -577,10 +3483,10 @@ static int alignment(block_t* block)
 }
 
 // helper function to return either the pointer is in the heap or not
-//static int in_heap(block_t* block)
-//{
-//    return (void)block <= mem_heap_hi() && (void)block >= mem_heap_lo();
-//}
+static int in_heap(block_t* block)
+{
+    return (void *)block <= mem_region_hi(arena->region) && (void *)block >= mem_region_lo(arena->region);
+}
 
 
 /*
@@ -602,10 +3508,21 @@ static size_t round_up(size_t size, size_t n)
 /*
  * pack: returns a header reflecting a specified size and its alloc status.
  *       If the block is allocated, the lowest bit is set to 1, and 0 otherwise.
+ *       The second lowest bit is set to 1 if the previous block is allocated,
+ *       and the third lowest bit if the previous block is a mini block.
  */
-static word_t pack(size_t size, bool alloc)
+static word_t pack(size_t size, bool prev_alloc, bool prev_mini, bool alloc)
 {
-    return alloc ? (size | alloc_mask) : size;
+    word_t word = size;
+    if (prev_alloc)
+    {
+        word |= prev_alloc_mask;
+    }
+    if (prev_mini)
+    {
+        word |= prev_mini_mask;
+    }
+    return alloc ? (word | alloc_mask) : word;
 }
 
 /*
@@ -627,13 +3544,13 @@ static size_t get_size(block_t *block)
 }
 
 /*
- * get_payload_size: returns the payload size of a given block, equal to
- *                   the entire block size minus the header and footer sizes.
+ * get_payload_size: returns the payload size of a given allocated block,
+ *                   equal to the entire block size minus the header size.
  */
 static word_t get_payload_size(block_t *block)
 {
     size_t asize = get_size(block);
-    return asize - dsize;
+    return asize - wsize;
 }
 
 /*
@@ -654,25 +3571,69 @@ static bool get_alloc(block_t *block)
     return extract_alloc(block->header);
 }
 
+/*
+ * get_prev_alloc: returns true when the block before this one is allocated,
+ *                 based on the second lowest bit of the block header.
+ */
+static bool get_prev_alloc(block_t *block)
+{
+    return (bool)(block->header & prev_alloc_mask);
+}
+
+/*
+ * get_prev_mini: returns true when the block before this one is a mini
+ *                block, based on the third lowest bit of the block header.
+ */
+static bool get_prev_mini(block_t *block)
+{
+    return (bool)(block->header & prev_mini_mask);
+}
+
 /*
  * write_header: given a block and its size and allocation status,
  *               writes an appropriate value to the block header.
  */
-static void write_header(block_t *block, size_t size, bool alloc)
+static void write_header(block_t *block, size_t size, bool prev_alloc, bool prev_mini, bool alloc)
 {
-    block->header = pack(size, alloc);
+    block->header = pack(size, prev_alloc, prev_mini, alloc);
 }
 
 
 /*
  * write_footer: given a block and its size and allocation status,
  *               writes an appropriate value to the block footer by first
- *               computing the position of the footer.
+ *               computing the position of the footer.  Mini blocks have no
+ *               room for a footer; the next block's header marks them instead.
  */
 static void write_footer(block_t *block, size_t size, bool alloc)
 {
+    if (size == mini_block_size)
+    {
+        return;
+    }
     word_t *footerp = (word_t *)((block->payload) + get_size(block) - dsize);
-    *footerp = pack(size, alloc);
+    *footerp = pack(size, false, false, alloc);
+}
+
+/*
+ * write_next_prev_bits: records the allocation status of a block, and
+ *                       whether it is a mini block, in the header of the
+ *                       block after it (possibly the epilogue).  Free
+ *                       blocks keep their footer as is, since only its
+ *                       size is ever read.
+ */
+static void write_next_prev_bits(block_t *block)
+{
+    block_t *block_next = find_next(block);
+    block_next->header &= ~(prev_alloc_mask | prev_mini_mask);
+    if (get_alloc(block))
+    {
+        block_next->header |= prev_alloc_mask;
+    }
+    if (get_size(block) == mini_block_size)
+    {
+        block_next->header |= prev_mini_mask;
+    }
 }
 
 
@@ -701,15 +3662,72 @@ static word_t *find_prev_footer(block_t *block)
 /*
  * find_prev: returns the previous block position by checking the previous
  *            block's footer and calculating the start of the previous block
- *            based on its size.
+ *            based on its size.  Only valid if the previous block is free.
+ *            A free mini block has no footer, but its size is known.
  */
 static block_t *find_prev(block_t *block)
 {
+    if (get_prev_mini(block))
+    {
+        return (block_t *)((char *)block - mini_block_size);
+    }
     word_t *footerp = find_prev_footer(block);
     size_t size = extract_size(*footerp);
     return (block_t *)((char *)block - size);
 }
 
+/*
+ * get_next: returns the block after block on its free list, or NULL.
+ */
+static block_t *get_next(block_t *block)
+{
+    if (COMPACT_LINKS)
+    {
+        return (block->next == 0) ? NULL : (block_t *)(link_base + (size_t)block->next);
+    }
+    return (block_t *)(uintptr_t)block->next;
+}
+
+/*
+ * get_previous: returns the block before block on its free list, or NULL.
+ */
+static block_t *get_previous(block_t *block)
+{
+    if (COMPACT_LINKS)
+    {
+        return (block->previous == 0) ? NULL : (block_t *)(link_base + (size_t)block->previous);
+    }
+    return (block_t *)(uintptr_t)block->previous;
+}
+
+/*
+ * set_next: makes next, which may be NULL, the block after block on its
+ *           free list.
+ */
+static void set_next(block_t *block, block_t *next)
+{
+    if (COMPACT_LINKS)
+    {
+        block->next = (link_t)(size_t)((next == NULL) ? 0 : (char *)next - link_base);
+        return;
+    }
+    block->next = (link_t)(uintptr_t)next;
+}
+
+/*
+ * set_previous: makes previous, which may be NULL, the block before block
+ *               on its free list.
+ */
+static void set_previous(block_t *block, block_t *previous)
+{
+    if (COMPACT_LINKS)
+    {
+        block->previous = (link_t)(size_t)((previous == NULL) ? 0 : (char *)previous - link_base);
+        return;
+    }
+    block->previous = (link_t)(uintptr_t)previous;
+}
+
 /*
  * payload_to_header: given a payload pointer, returns a pointer to the
  *                    corresponding block.
@@ -8,6 +8,10 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 extern void *mm_calloc (size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern void *mm_aligned_alloc(size_t alignment, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+extern size_t mm_malloc_usable_size(void *ptr);
 
 #else
 
@@ -16,10 +20,54 @@ extern void *malloc (size_t size);
 extern void free (void *ptr);
 extern void *realloc(void *ptr, size_t size);
 extern void *calloc (size_t nmemb, size_t size);
+extern void *memalign(size_t alignment, size_t size);
+extern void *aligned_alloc(size_t alignment, size_t size);
+extern int posix_memalign(void **memptr, size_t alignment, size_t size);
+extern size_t malloc_usable_size(void *ptr);
 
 #endif
 
 extern bool mm_init(void);
 
+/* True if the package may be called from several threads at once */
+extern const bool mm_thread_safe;
+
+/* Frees ptr, which was allocated or last reallocated with size bytes */
+extern void mm_free_sized(void *ptr, size_t size);
+
+/* Allocate or free many blocks at once; mm_free_batch sorts ptrs in place */
+extern size_t mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/* Gives free memory at the top of the heap back, keeping pad bytes */
+extern bool mm_trim(size_t pad);
+
+/* What the allocator is doing.  Free blocks are counted by size class,
+   class i holding sizes in [16 << i, 16 << (i + 1)) and the last class
+   everything bigger.  The event counts are only kept in builds with
+   MM_STATS set; mm_get_stats returns false, and leaves them 0, otherwise */
+#define MM_STATS_CLASSES 16
+struct mm_stats {
+    size_t live_bytes;                    /* payload bytes handed out, mapped blocks whole */
+    size_t free_bytes;                    /* bytes in free heap blocks */
+    size_t free_blocks[MM_STATS_CLASSES]; /* free heap blocks per size class */
+    size_t splits;                        /* free blocks split to place a smaller one */
+    size_t coalesces;                     /* merges of a free block with a neighbour */
+    size_t fit_calls;                     /* searches of the free lists */
+    double fit_probes_mean;               /* free blocks looked at per search */
+    size_t fit_probes_max;                /* most free blocks one search looked at */
+    size_t extend_calls;                  /* times the heap was extended */
+};
+extern bool mm_get_stats(struct mm_stats *stats);
+
+/* How free blocks are put on the free lists, for comparing utilization */
+typedef enum { MM_INSERT_LIFO, MM_INSERT_ADDRESS } mm_insert_policy_t;
+extern void mm_set_insert_policy(mm_insert_policy_t policy);
+
+/* How find_fit searches the free lists, for comparing throughput and util */
+typedef enum { MM_FIT_FIRST, MM_FIT_NEXT, MM_FIT_GOOD } mm_fit_policy_t;
+extern void mm_set_fit_policy(mm_fit_policy_t policy);
+extern void mm_set_fit_scan_limit(size_t limit);
+
 /* This is for debugging.  Returns false if error encountered */
 extern bool mm_checkheap(int lineno);